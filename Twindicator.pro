@@ -15,7 +15,7 @@
 
 TARGET = Twindicator
 TEMPLATE = app
-QT       += core gui network widgets
+QT       += core gui network widgets concurrent
 
 include(Twindicator.pri)
 DEFINES += \
@@ -43,11 +43,47 @@ INCLUDEPATH += 3rdparty/oauth
 SOURCES += main.cpp \
         mainwindow.cpp \
     globals.cpp \
-    flowlayout.cpp
+    labeljournal.cpp \
+    tweetstore.cpp \
+    labelarchive.cpp \
+    snapshotwriter.cpp \
+    metrics.cpp \
+    tweet.cpp \
+    tweetprojection.cpp \
+    timelinebackfill.cpp \
+    mocktwitterserver.cpp \
+    refreshscheduler.cpp \
+    jsonstreamparser.cpp \
+    avatarfetcher.cpp \
+    thumbnailcache.cpp \
+    avatarcache.cpp \
+    tweettablemodel.cpp \
+    tokenstrip.cpp \
+    frameclock.cpp \
+    framestats.cpp \
+    ingestdriver.cpp
 
 HEADERS  += mainwindow.h \
     globals.h \
-    flowlayout.h
+    labeljournal.h \
+    tweetstore.h \
+    labelarchive.h \
+    snapshotwriter.h \
+    metrics.h \
+    tweet.h \
+    tweetprojection.h \
+    timelinebackfill.h \
+    mocktwitterserver.h \
+    refreshscheduler.h \
+    jsonstreamparser.h \
+    avatarfetcher.h \
+    thumbnailcache.h \
+    avatarcache.h \
+    tweettablemodel.h \
+    tokenstrip.h \
+    frameclock.h \
+    framestats.h \
+    ingestdriver.h
 
 FORMS    += mainwindow.ui
 
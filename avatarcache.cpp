@@ -0,0 +1,130 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "avatarcache.h"
+#include "metrics.h"
+
+
+AvatarCache::AvatarCache(void)
+  : mClock(0)
+  , mBytes(0)
+  , mMaxBytes(DefaultMaxBytes)
+  , mHits(0)
+  , mMisses(0)
+  , mEvictions(0)
+{
+  /* ... */
+}
+
+
+void AvatarCache::setMaxBytes(qint64 maxBytes)
+{
+  mMaxBytes = qMax(Q_INT64_C(0), maxBytes);
+  evict();
+}
+
+
+void AvatarCache::setVisible(const QSet<QUrl> &urls)
+{
+  mVisible = urls;
+}
+
+
+bool AvatarCache::find(const QUrl &url, QPixmap *pix)
+{
+  QHash<QUrl, Entry>::iterator i = mEntries.find(url);
+  if (i == mEntries.end()) {
+    if (!mMissed.contains(url)) {
+      mMissed.insert(url);
+      ++mMisses;
+    }
+    return false;
+  }
+  touch(url, i.value());
+  *pix = i.value().pix;
+  ++mHits;
+  return true;
+}
+
+
+void AvatarCache::insert(const QUrl &url, const QPixmap &pix)
+{
+  remove(url);
+  mMissed.remove(url);
+  Entry entry;
+  entry.pix = pix;
+  entry.bytes = qint64(pix.width()) * pix.height() * qMax(1, pix.depth()) / 8;
+  entry.lastUsed = 0;
+  touch(url, entry);
+  mEntries.insert(url, entry);
+  mBytes += entry.bytes;
+  evict();
+}
+
+
+void AvatarCache::touch(const QUrl &url, Entry &entry)
+{
+  mRecency.remove(entry.lastUsed);
+  entry.lastUsed = ++mClock;
+  mRecency.insert(entry.lastUsed, url);
+}
+
+
+// Two passes over the avatars from least to most recently used: the
+// first spares the visible ones, the second doesn't.
+void AvatarCache::evict(void)
+{
+  for (int pass = 0; pass < 2 && mBytes > mMaxBytes; ++pass) {
+    QMap<quint64, QUrl>::iterator i = mRecency.begin();
+    while (i != mRecency.end() && mBytes > mMaxBytes) {
+      if (pass == 0 && mVisible.contains(i.value())) {
+        ++i;
+        continue;
+      }
+      const QUrl url = i.value();
+      i = mRecency.erase(i);
+      mBytes -= mEntries.take(url).bytes;
+      ++mEvictions;
+    }
+  }
+  publish();
+}
+
+
+void AvatarCache::remove(const QUrl &url)
+{
+  QHash<QUrl, Entry>::iterator i = mEntries.find(url);
+  if (i == mEntries.end())
+    return;
+  mRecency.remove(i.value().lastUsed);
+  mBytes -= i.value().bytes;
+  mEntries.erase(i);
+}
+
+
+// find() is called for every paint of an avatar cell, so it only counts;
+// the counts are handed to Metrics from here.
+void AvatarCache::publish(void) const
+{
+  Metrics::set("avatarCache/hits", mHits);
+  Metrics::set("avatarCache/misses", mMisses);
+  Metrics::set("avatarCache/evictions", mEvictions);
+  Metrics::set("avatarCache/residentBytes", mBytes);
+  Metrics::set("avatarCache/entries", mEntries.count());
+}
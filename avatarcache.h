@@ -0,0 +1,72 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __AVATARCACHE_H_
+#define __AVATARCACHE_H_
+
+#include <QUrl>
+#include <QPixmap>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+
+
+// In-memory avatar pixmaps within a fixed byte budget. When the budget
+// is exceeded, the least recently used avatars are dropped, those shown
+// in visible rows only if nothing else is left. Hits, misses, evictions
+// and resident bytes are published as Metrics whenever the content
+// changes; a URL counts as one miss until it is inserted, however often
+// its rows are repainted meanwhile.
+class AvatarCache
+{
+public:
+  enum { DefaultMaxBytes = 8 * 1024 * 1024 };
+
+  AvatarCache(void);
+
+  void setMaxBytes(qint64 maxBytes);
+  void setVisible(const QSet<QUrl> &urls);
+  bool find(const QUrl &url, QPixmap *pix);
+  void insert(const QUrl &url, const QPixmap &pix);
+
+private:
+  struct Entry {
+    QPixmap pix;
+    qint64 bytes;
+    quint64 lastUsed;
+  };
+
+  void touch(const QUrl &url, Entry &entry);
+  void evict(void);
+  void remove(const QUrl &url);
+  void publish(void) const;
+
+  QHash<QUrl, Entry> mEntries;
+  QMap<quint64, QUrl> mRecency; // least recently used first
+  QSet<QUrl> mVisible;
+  QSet<QUrl> mMissed; // not inserted since their miss was counted
+  quint64 mClock;
+  qint64 mBytes;
+  qint64 mMaxBytes;
+  qint64 mHits;
+  qint64 mMisses;
+  qint64 mEvictions;
+};
+
+#endif // __AVATARCACHE_H_
@@ -0,0 +1,98 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+
+#include "avatarfetcher.h"
+#include "metrics.h"
+
+
+AvatarFetcher::AvatarFetcher(QNetworkAccessManager *nam, QObject *parent)
+  : QObject(parent)
+  , mNAM(nam)
+  , mMaxConcurrent(DefaultMaxConcurrent)
+  , mRunning(0)
+{
+  /* ... */
+}
+
+
+void AvatarFetcher::setMaxConcurrent(int n)
+{
+  mMaxConcurrent = qMax(1, n);
+  dispatch();
+}
+
+
+void AvatarFetcher::fetch(const QUrl &url)
+{
+  if (!url.isValid())
+    return;
+  if (mPending.contains(url)) {
+    Metrics::add("avatars/coalesced");
+    return;
+  }
+  mPending.insert(url);
+  mQueue.enqueue(url);
+  dispatch();
+}
+
+
+// To be called when the data passed on by fetched() has been dealt with.
+void AvatarFetcher::done(const QUrl &url)
+{
+  mPending.remove(url);
+}
+
+
+void AvatarFetcher::dispatch(void)
+{
+  while (mRunning < mMaxConcurrent && !mQueue.isEmpty()) {
+    QNetworkRequest request(mQueue.dequeue());
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
+    QNetworkReply *reply = mNAM->get(request);
+    QObject::connect(reply, SIGNAL(finished()), SLOT(onReplyFinished()));
+    ++mRunning;
+    Metrics::add("avatars/requested");
+  }
+  Metrics::set("avatars/queued", mQueue.count());
+}
+
+
+void AvatarFetcher::onReplyFinished(void)
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (reply == Q_NULLPTR)
+    return;
+  reply->deleteLater();
+  --mRunning;
+  const QUrl &url = reply->request().url();
+  if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool())
+    Metrics::add("avatars/fromDiskCache");
+  if (reply->error() == QNetworkReply::NoError) {
+    emit fetched(url, reply->readAll());
+  }
+  else {
+    Metrics::add("avatars/errors");
+    mPending.remove(url);
+    emit failed(url);
+  }
+  dispatch();
+}
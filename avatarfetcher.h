@@ -0,0 +1,68 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __AVATARFETCHER_H_
+#define __AVATARFETCHER_H_
+
+#include <QObject>
+#include <QUrl>
+#include <QSet>
+#include <QQueue>
+#include <QByteArray>
+#include <QNetworkReply>
+
+class QNetworkAccessManager;
+
+
+// Downloads profile images with at most one request per URL in flight;
+// further requests for the same URL wait for that one. No more than a
+// configurable number of requests run at a time, the rest are queued.
+// A URL fetched successfully counts as pending until done() is called,
+// so that it is not requested again while its image is being decoded.
+class AvatarFetcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum { DefaultMaxConcurrent = 4 };
+
+  explicit AvatarFetcher(QNetworkAccessManager *nam, QObject *parent = Q_NULLPTR);
+
+  void setMaxConcurrent(int n);
+  void fetch(const QUrl &url);
+  void done(const QUrl &url);
+
+signals:
+  void fetched(const QUrl &url, const QByteArray &data);
+  void failed(const QUrl &url);
+
+private slots:
+  void onReplyFinished(void);
+
+private:
+  void dispatch(void);
+
+  QNetworkAccessManager *mNAM;
+  int mMaxConcurrent;
+  int mRunning;
+  QSet<QUrl> mPending; // queued, in flight or being processed
+  QQueue<QUrl> mQueue;
+};
+
+#endif // __AVATARFETCHER_H_
@@ -0,0 +1,67 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include "frameclock.h"
+
+
+FrameClock::FrameClock(QObject *parent)
+  : QAbstractAnimation(parent)
+  , mLastNs(0)
+  , mFirst(true)
+{
+  /* ... */
+}
+
+
+int FrameClock::duration(void) const
+{
+  return -1;
+}
+
+
+void FrameClock::updateCurrentTime(int)
+{
+  if (!mTimer.isValid())
+    return;
+  const qint64 now = mTimer.nsecsElapsed();
+  const qint64 interval = now - mLastNs;
+  mLastNs = now;
+  // the first call comes from start() itself, not from a frame
+  if (mFirst) {
+    mFirst = false;
+    return;
+  }
+  if (interval > 0)
+    emit frame(interval);
+}
+
+
+void FrameClock::updateState(QAbstractAnimation::State newState, QAbstractAnimation::State oldState)
+{
+  Q_UNUSED(oldState);
+  if (newState == QAbstractAnimation::Running) {
+    mTimer.start();
+    mLastNs = 0;
+    mFirst = true;
+  }
+  else {
+    mTimer.invalidate();
+  }
+}
@@ -0,0 +1,57 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __FRAMECLOCK_H_
+#define __FRAMECLOCK_H_
+
+#include <QAbstractAnimation>
+#include <QElapsedTimer>
+
+
+// Ticks once per animation frame, driven by the same timer as Qt's
+// property animations, and reports the time elapsed since the previous
+// frame. Runs until stopped.
+class FrameClock : public QAbstractAnimation
+{
+  Q_OBJECT
+
+public:
+  // period of Qt's animation timer, which is not tied to the display's
+  // refresh rate
+  enum { IntervalMs = 16 };
+
+  explicit FrameClock(QObject *parent = Q_NULLPTR);
+
+  int duration(void) const Q_DECL_OVERRIDE;
+
+signals:
+  void frame(qint64 intervalNs);
+
+protected:
+  void updateCurrentTime(int) Q_DECL_OVERRIDE;
+  void updateState(QAbstractAnimation::State newState, QAbstractAnimation::State oldState) Q_DECL_OVERRIDE;
+
+private:
+  QElapsedTimer mTimer;
+  qint64 mLastNs;
+  bool mFirst;
+};
+
+#endif // __FRAMECLOCK_H_
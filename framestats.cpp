@@ -0,0 +1,121 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSaveFile>
+
+#include "framestats.h"
+#include "metrics.h"
+
+
+FrameStats::FrameStats(void)
+  : mFrameNs(1e9 / 60)
+  , mRecording(false)
+  , mHistogram(BucketCount + 1, 0)
+{
+  /* ... */
+}
+
+
+// Sets the period frames are expected at, i.e. that of the timer
+// driving the animations rather than the display's refresh period.
+void FrameStats::setFrameInterval(qint64 ns)
+{
+  if (ns > 0)
+    mFrameNs = ns;
+}
+
+
+void FrameStats::begin(void)
+{
+  mCurrent = Swipe();
+  mRecording = true;
+}
+
+
+void FrameStats::addFrame(qint64 intervalNs)
+{
+  if (!mRecording)
+    return;
+  mCurrent.intervalsNs.append(intervalNs);
+  mCurrent.worstNs = qMax(mCurrent.worstNs, intervalNs);
+  const int missed = qRound(intervalNs / mFrameNs) - 1;
+  if (missed > 0)
+    mCurrent.missed += missed;
+  const int bucket = qMin(int(intervalNs / (BucketMs * 1000000)), int(BucketCount));
+  ++mHistogram[bucket];
+}
+
+
+void FrameStats::end(void)
+{
+  if (!mRecording)
+    return;
+  mRecording = false;
+  Metrics::add("frames/swipes");
+  Metrics::add("frames/total", mCurrent.intervalsNs.count());
+  Metrics::add("frames/missed", mCurrent.missed);
+  Metrics::set("frames/worstNs", qMax(Metrics::value("frames/worstNs"), mCurrent.worstNs));
+  // published here rather than per frame, so that measuring a frame
+  // doesn't add to its cost
+  for (int bucket = 0; bucket <= BucketCount; ++bucket) {
+    if (mHistogram.at(bucket) > 0)
+      Metrics::set(bucket < BucketCount
+                   ? QString("frames/hist/%1-%2ms").arg(bucket * BucketMs, 2, 10, QChar('0')).arg((bucket + 1) * BucketMs, 2, 10, QChar('0'))
+                   : QString("frames/hist/%1+ms").arg(BucketCount * BucketMs),
+                   mHistogram.at(bucket));
+  }
+  mSwipes.append(mCurrent);
+  if (mSwipes.count() > MaxSwipes)
+    mSwipes.removeFirst();
+}
+
+
+// Writes the nominal frame interval, the histogram and the frame intervals of
+// the recorded swipes in microseconds.
+bool FrameStats::save(const QString &filename) const
+{
+  QJsonArray histogram;
+  foreach (qint64 n, mHistogram)
+    histogram.append(double(n));
+  QJsonArray swipes;
+  foreach (Swipe swipe, mSwipes) {
+    QJsonArray intervals;
+    foreach (qint64 ns, swipe.intervalsNs)
+      intervals.append(double(ns / 1000));
+    QJsonObject s;
+    s["missed"] = swipe.missed;
+    s["worstUs"] = double(swipe.worstNs / 1000);
+    s["intervalsUs"] = intervals;
+    swipes.append(s);
+  }
+  QJsonObject root;
+  root["frameUs"] = qRound(mFrameNs / 1000);
+  root["bucketMs"] = int(BucketMs);
+  root["histogram"] = histogram;
+  root["swipes"] = swipes;
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  return file.commit();
+}
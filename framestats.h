@@ -0,0 +1,65 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __FRAMESTATS_H_
+#define __FRAMESTATS_H_
+
+#include <QString>
+#include <QVector>
+#include <QList>
+
+
+// Frame times of swipe animations. Each swipe records its frame
+// intervals; a frame counts as missed for every nominal frame interval
+// it overran. Totals and a histogram of all intervals are published as
+// Metrics, and the recorded swipes can be saved as JSON to compare runs.
+class FrameStats
+{
+public:
+  enum {
+    BucketMs = 2,
+    BucketCount = 32,
+    MaxSwipes = 1000
+  };
+
+  FrameStats(void);
+
+  void setFrameInterval(qint64 ns);
+  void begin(void);
+  void addFrame(qint64 intervalNs);
+  void end(void);
+  bool save(const QString &filename) const;
+
+private:
+  struct Swipe {
+    Swipe(void) : missed(0), worstNs(0) { /* ... */ }
+    QVector<qint64> intervalsNs;
+    int missed;
+    qint64 worstNs;
+  };
+
+  qreal mFrameNs;
+  bool mRecording;
+  Swipe mCurrent;
+  QList<Swipe> mSwipes;
+  QVector<qint64> mHistogram;
+};
+
+#endif // __FRAMESTATS_H_
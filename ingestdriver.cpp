@@ -0,0 +1,137 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QSettings>
+
+#include "ingestdriver.h"
+#include "mocktwitterserver.h"
+#include "timelinebackfill.h"
+#include "metrics.h"
+
+
+IngestDriver::IngestDriver(const QSettings &settings, QObject *parent)
+  : QObject(parent)
+  , mServer(Q_NULLPTR)
+  , mRefreshesLeft(settings.value("mock/refreshes", 0).toInt())
+  , mRefreshes(0)
+  , mTweets(0)
+  , mMs(0)
+  , mMaxPages(0)
+  , mFloorId(0)
+{
+  MockTwitterServer::Options options;
+  options.port = quint16(settings.value("mock/port", 0).toInt());
+  options.history = settings.value("mock/history", options.history).toInt();
+  options.tweetsPerSecond = settings.value("mock/tweetsPerSecond", options.tweetsPerSecond).toInt();
+  options.users = settings.value("mock/users", options.users).toInt();
+  options.latencyMs = settings.value("mock/latency", options.latencyMs).toInt();
+  options.errorRate = settings.value("mock/errorRate", options.errorRate).toReal();
+  options.rateLimit = settings.value("mock/rateLimit", options.rateLimit).toInt();
+  options.avatarSize = settings.value("mock/avatarSize", options.avatarSize).toInt();
+  options.burst = settings.value("mock/burst", options.burst).toInt();
+  options.bursts = settings.value("mock/bursts", options.bursts).toInt();
+  options.deletedRate = settings.value("mock/deletedRate", options.deletedRate).toReal();
+  if (settings.value("mock/scenario").toString() == "gapResume") {
+    // more tweets arrive at once than the page budget of a refresh can
+    // fetch; the following refreshes must pick up the open gaps, and
+    // short pages must not be taken for the end of a gap
+    options.history = 400;
+    options.tweetsPerSecond = 0;
+    options.errorRate = 0;
+    options.rateLimit = 0;
+    options.burst = 10 * TimelineBackfill::DefaultPageSize;
+    options.bursts = 1;
+    options.deletedRate = 0.05;
+    mMaxPages = 2;
+    mRefreshesLeft = 16;
+  }
+  mServer = new MockTwitterServer(options, this);
+}
+
+
+bool IngestDriver::listen(void)
+{
+  return mServer->listen();
+}
+
+
+QUrl IngestDriver::baseUrl(void) const
+{
+  return mServer->baseUrl();
+}
+
+
+// The page budget the scenario requires, 0 if it doesn't care.
+int IngestDriver::maxPages(void) const
+{
+  return mMaxPages;
+}
+
+
+// Returns true if another driven refresh is due, counting it as started.
+bool IngestDriver::takeRefresh(void)
+{
+  if (mRefreshesLeft <= 0)
+    return false;
+  --mRefreshesLeft;
+  return true;
+}
+
+
+// `sinceId` of the first refresh is the floor above which check()
+// expects every tweet.
+void IngestDriver::refreshStarted(qlonglong sinceId)
+{
+  if (mFloorId == 0)
+    mFloorId = sinceId;
+}
+
+
+void IngestDriver::refreshFinished(int tweets, qint64 ms)
+{
+  ++mRefreshes;
+  mTweets += tweets;
+  mMs += ms;
+}
+
+
+// Reports the throughput of the refreshes so far and the number of
+// tweets above the floor that are not among `knownIds`.
+void IngestDriver::check(const QSet<qlonglong> &knownIds, int openGaps)
+{
+  if (mRefreshes < 2)
+    return;
+  qDebug() << "ingest driver:" << mRefreshes << "refreshes," << mTweets << "tweets,"
+           << 1000 * mTweets / qMax(Q_INT64_C(1), mMs) << "tweets/s,"
+           << mMs / mRefreshes << "ms per refresh," << mServer->requestCount() << "requests";
+  int missing = 0;
+  if (mFloorId > 0) {
+    foreach (qlonglong id, mServer->idsNewerThan(mFloorId)) {
+      if (!knownIds.contains(id))
+        ++missing;
+    }
+  }
+  Metrics::set("ingest/missing", missing);
+  Metrics::set("ingest/openGaps", openGaps);
+  if (missing > 0)
+    qWarning() << "ingest driver:" << missing << "tweets missing," << openGaps << "gaps still open";
+  else
+    qDebug() << "ingest driver: no tweets missing above id" << mFloorId;
+}
@@ -0,0 +1,61 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __INGESTDRIVER_H_
+#define __INGESTDRIVER_H_
+
+#include <QObject>
+#include <QUrl>
+#include <QSet>
+
+class QSettings;
+class MockTwitterServer;
+
+
+// Runs the app against a MockTwitterServer: drives a configured number
+// of refreshes back to back, reports the ingest throughput and checks
+// that every tweet published above the watermark of the first driven
+// refresh has arrived. Configured from the mock/ settings; mock/scenario
+// selects a canned setup, e.g. "gapResume".
+class IngestDriver : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit IngestDriver(const QSettings &settings, QObject *parent = Q_NULLPTR);
+
+  bool listen(void);
+  QUrl baseUrl(void) const;
+  int maxPages(void) const;
+  bool takeRefresh(void);
+  void refreshStarted(qlonglong sinceId);
+  void refreshFinished(int tweets, qint64 ms);
+  void check(const QSet<qlonglong> &knownIds, int openGaps);
+
+private:
+  MockTwitterServer *mServer;
+  int mRefreshesLeft;
+  int mRefreshes;
+  qint64 mTweets;
+  qint64 mMs;
+  int mMaxPages;
+  qlonglong mFloorId;
+};
+
+#endif // __INGESTDRIVER_H_
@@ -0,0 +1,154 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <cctype>
+
+#include "jsonstreamparser.h"
+
+
+JsonStreamParser::JsonStreamParser(void)
+{
+  reset();
+}
+
+
+void JsonStreamParser::reset(void)
+{
+  mState = Start;
+  mBuffer.clear();
+  mScanned = 0;
+  mDepth = 0;
+  mInString = false;
+  mEscaped = false;
+  mObjectCount = 0;
+}
+
+
+// Consumes the next chunk of the reply and returns the objects it
+// completed. Anything that is not an array of objects puts the parser
+// into the error state.
+QJsonArray JsonStreamParser::feed(const QByteArray &data)
+{
+  QJsonArray objects;
+  if (mState == Done || mState == Error)
+    return objects;
+  mBuffer.append(data);
+  const char *p = mBuffer.constData();
+  int i = mScanned;
+  int start = 0;
+  for ( ; i < mBuffer.size(); ++i) {
+    const char c = p[i];
+    switch (mState) {
+    case Start:
+      if (c == '[')
+        mState = InArray;
+      else if (!isspace(uchar(c)))
+        mState = Error;
+      start = i + 1;
+      break;
+    case InArray:
+      if (c == '{') {
+        mState = InObject;
+        mDepth = 1;
+        start = i;
+      }
+      else if (c == ']') {
+        mState = Done;
+        start = i + 1;
+      }
+      else if (c != ',' && !isspace(uchar(c))) {
+        mState = Error;
+      }
+      else {
+        start = i + 1;
+      }
+      break;
+    case InObject:
+      if (mInString) {
+        if (mEscaped)
+          mEscaped = false;
+        else if (c == '\\')
+          mEscaped = true;
+        else if (c == '"')
+          mInString = false;
+      }
+      else if (c == '"') {
+        mInString = true;
+      }
+      else if (c == '{' || c == '[') {
+        ++mDepth;
+      }
+      else if (c == '}' || c == ']') {
+        if (--mDepth == 0) {
+          QJsonParseError error;
+          const QJsonDocument &doc = QJsonDocument::fromJson(QByteArray::fromRawData(p + start, i + 1 - start), &error);
+          if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+            mState = Error;
+            break;
+          }
+          objects.append(doc.object());
+          ++mObjectCount;
+          mState = InArray;
+          start = i + 1;
+        }
+      }
+      break;
+    default:
+      break;
+    }
+    if (mState == Done || mState == Error)
+      break;
+  }
+  // drop everything before the element still being received
+  if (mState == InObject) {
+    mBuffer.remove(0, start);
+    mScanned = i - start;
+  }
+  else {
+    mBuffer.clear();
+    mScanned = 0;
+  }
+  return objects;
+}
+
+
+// Marks the end of the input. An array that has not been closed by
+// then, e.g. because the connection dropped, is an error.
+void JsonStreamParser::finish(void)
+{
+  if (mState != Done)
+    mState = Error;
+  mBuffer.clear();
+  mScanned = 0;
+}
+
+
+bool JsonStreamParser::hasError(void) const
+{
+  return mState == Error;
+}
+
+
+int JsonStreamParser::objectCount(void) const
+{
+  return mObjectCount;
+}
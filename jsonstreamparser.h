@@ -0,0 +1,62 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __JSONSTREAMPARSER_H_
+#define __JSONSTREAMPARSER_H_
+
+#include <QByteArray>
+#include <QJsonArray>
+
+
+// Splits a JSON array of objects, e.g. a timeline reply, into its
+// elements while the bytes are still arriving. Only the bytes of the
+// element being received are buffered; each complete element is
+// parsed on its own as soon as its closing brace has been seen. Once
+// the input is complete, finish() tells a truncated array from a
+// complete one.
+class JsonStreamParser
+{
+public:
+  JsonStreamParser(void);
+
+  QJsonArray feed(const QByteArray &data);
+  void finish(void);
+  void reset(void);
+  bool hasError(void) const;
+  int objectCount(void) const;
+
+private:
+  enum State {
+    Start,
+    InArray,
+    InObject,
+    Done,
+    Error
+  };
+
+  State mState;
+  QByteArray mBuffer;
+  int mScanned;
+  int mDepth;
+  bool mInString;
+  bool mEscaped;
+  int mObjectCount;
+};
+
+#endif // __JSONSTREAMPARSER_H_
@@ -0,0 +1,322 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#include "labelarchive.h"
+
+// Segment layout (all integers little endian):
+//
+//   header   magic "TWSG", version, tweet count, reserved,
+//            minimum id, maximum id, compressed payload size (64 bit each)
+//   ids      tweet count ids (64 bit), ascending
+//   payload  qCompress()ed TweetStore data of the same tweets
+static const char SegmentMagic[4] = { 'T', 'W', 'S', 'G' };
+static const quint32 SegmentVersion = 1;
+static const int SegmentHeaderSize = 40;
+
+
+LabelArchive::LabelArchive(void)
+  : mHotLimit(DefaultHotLimit)
+  , mNextSegment(1)
+{
+  /* ... */
+}
+
+
+// Opens the current file of the hot store `filename` and reads the
+// headers of all segments belonging to it, e.g. good_tweets_of_4711.0001.seg
+// for good_tweets_of_4711.tws.
+bool LabelArchive::open(const QString &filename)
+{
+  mFilename = filename;
+  mSegments.clear();
+  mNextSegment = 1;
+  const QFileInfo fi(filename);
+  const QStringList &segmentFiles = fi.dir().entryList(QStringList() << segmentNameFilter(filename), QDir::Files, QDir::Name);
+  foreach (QString segmentFile, segmentFiles) {
+    loadSegment(fi.dir().filePath(segmentFile));
+    const QStringList &parts = segmentFile.split('.');
+    if (parts.count() >= 3)
+      mNextSegment = qMax(mNextSegment, parts.at(parts.count() - 2).toInt() + 1);
+  }
+  if (!mHot.open(TweetStore::currentFile(filename)))
+    return false;
+  // a crash after a segment was written but before the hot store was
+  // rewritten leaves the sealed tweets in both
+  int duplicates = 0;
+  for (int i = mHot.count() - 1; i >= 0; --i) {
+    const qlonglong id = mHot.idAt(i);
+    if (sealed(id) && mHot.remove(id))
+      ++duplicates;
+  }
+  if (duplicates > 0)
+    qDebug() << "LabelArchive::open()" << duplicates << "tweets already sealed dropped from" << filename;
+  return true;
+}
+
+
+// Writes the segments sealed since they were opened, then the hot store.
+// Being const, it can run on a copy of the archive in another thread.
+bool LabelArchive::save(const QString &filename) const
+{
+  foreach (const Segment &segment, mSegments) {
+    if (!segment.unsaved.isNull() && !QFile::exists(segment.filename) && !writeSegment(segment))
+      return false;
+  }
+  return mHot.save(filename);
+}
+
+
+// Switches the hot store to the file just written by save() and releases
+// the in-memory copies of segments that now exist on disk.
+bool LabelArchive::rebase(const QString &filename)
+{
+  for (int i = 0; i < mSegments.count(); ++i) {
+    if (!mSegments.at(i).unsaved.isNull() && QFile::exists(mSegments.at(i).filename))
+      mSegments[i].unsaved.clear();
+  }
+  return mHot.rebase(filename);
+}
+
+
+// Reduces all tweets to the fields selected by `projection`. Segments
+// on disk are rewritten in place; the hot store is replaced by an
+// in-memory copy which the next save() writes.
+bool LabelArchive::project(const TweetProjection &projection)
+{
+  bool ok = true;
+  for (int i = 0; i < mSegments.count(); ++i) {
+    Segment &segment = mSegments[i];
+    const TweetStore &tweets = segment.unsaved.isNull() ? segmentTweets(segment) : *segment.unsaved;
+    segment.unsaved = QSharedPointer<TweetStore>(new TweetStore(tweets.projected(projection)));
+    if (QFile::exists(segment.filename)) {
+      ok = writeSegment(segment) && ok;
+      segment.unsaved.clear();
+    }
+  }
+  mHot = mHot.projected(projection);
+  return ok;
+}
+
+
+void LabelArchive::setHotLimit(int limit)
+{
+  mHotLimit = qMax(1, limit);
+}
+
+
+int LabelArchive::count(void) const
+{
+  int n = mHot.count();
+  foreach (const Segment &segment, mSegments)
+    n += segment.ids.count();
+  return n;
+}
+
+
+bool LabelArchive::isEmpty(void) const
+{
+  return count() == 0;
+}
+
+
+bool LabelArchive::contains(qlonglong id) const
+{
+  return mHot.contains(id) || sealed(id);
+}
+
+
+bool LabelArchive::insert(const QJsonObject &tweet)
+{
+  if (contains(TweetStore::tweetId(tweet)))
+    return false;
+  return mHot.insert(tweet);
+}
+
+
+// Returns the labeled tweet with the given id. If it has been sealed, the
+// segment containing it is decompressed on demand.
+QJsonObject LabelArchive::find(qlonglong id) const
+{
+  const int i = mHot.indexOf(id);
+  if (i >= 0)
+    return mHot.at(i);
+  foreach (const Segment &segment, mSegments) {
+    if (id < segment.minId || id > segment.maxId)
+      continue;
+    if (std::binary_search(segment.ids.constBegin(), segment.ids.constEnd(), id)) {
+      const TweetStore &tweets = segment.unsaved.isNull() ? segmentTweets(segment) : *segment.unsaved;
+      const int j = tweets.indexOf(id);
+      return j >= 0 ? tweets.at(j) : QJsonObject();
+    }
+  }
+  return QJsonObject();
+}
+
+
+qlonglong LabelArchive::mostRecentId(void) const
+{
+  qlonglong id = mHot.isEmpty() ? 0 : mHot.idAt(0);
+  foreach (const Segment &segment, mSegments)
+    id = qMax(id, segment.maxId);
+  return id;
+}
+
+
+const TweetStore &LabelArchive::hot(void) const
+{
+  return mHot;
+}
+
+
+// Returns the ids of all labeled tweets, hot and sealed, in no particular order.
+QVector<qlonglong> LabelArchive::ids(void) const
+{
+  QVector<qlonglong> result;
+  result.reserve(count());
+  for (int i = 0; i < mHot.count(); ++i)
+    result.append(mHot.idAt(i));
+  foreach (const Segment &segment, mSegments)
+    result += segment.ids;
+  return result;
+}
+
+
+// Moves all but the most recent hot tweets into a new segment if the hot
+// store has grown to twice its limit. The segment is kept in memory until
+// save() has written it.
+bool LabelArchive::seal(void)
+{
+  if (mHot.count() < 2 * mHotLimit)
+    return false;
+  QSharedPointer<TweetStore> sealed(new TweetStore);
+  Segment segment;
+  segment.ids.reserve(mHot.count() - mHotLimit);
+  for (int i = mHot.count() - 1; i >= mHotLimit; --i) {
+    sealed->insert(mHot.at(i));
+    segment.ids.append(mHot.idAt(i));
+  }
+  segment.minId = segment.ids.first();
+  segment.maxId = segment.ids.last();
+  segment.unsaved = sealed;
+  const QFileInfo fi(mFilename);
+  segment.filename = fi.path() + "/" + fi.completeBaseName() + QString(".%1.seg").arg(mNextSegment++, 4, 10, QChar('0'));
+  mSegments.append(segment);
+  mHot.truncate(mHotLimit);
+  return true;
+}
+
+
+bool LabelArchive::writeSegment(const Segment &segment) const
+{
+  const QByteArray &payload = qCompress(segment.unsaved->toByteArray());
+  uchar header[SegmentHeaderSize];
+  std::memcpy(header, SegmentMagic, sizeof(SegmentMagic));
+  qToLittleEndian<quint32>(SegmentVersion, header + 4);
+  qToLittleEndian<quint32>(quint32(segment.ids.count()), header + 8);
+  qToLittleEndian<quint32>(0, header + 12);
+  qToLittleEndian<qint64>(segment.minId, header + 16);
+  qToLittleEndian<qint64>(segment.maxId, header + 24);
+  qToLittleEndian<qint64>(payload.size(), header + 32);
+  QByteArray ids(segment.ids.count() * 8, Qt::Uninitialized);
+  for (int i = 0; i < segment.ids.count(); ++i)
+    qToLittleEndian<qint64>(segment.ids.at(i), reinterpret_cast<uchar*>(ids.data()) + 8 * i);
+
+  QSaveFile file(segment.filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(reinterpret_cast<const char*>(header), SegmentHeaderSize);
+  file.write(ids);
+  file.write(payload);
+  if (!file.commit()) {
+    qWarning() << "LabelArchive::writeSegment() cannot write" << segment.filename;
+    return false;
+  }
+  qDebug() << "LabelArchive::writeSegment()" << segment.filename << segment.ids.count() << "tweets," << payload.size() << "bytes";
+  return true;
+}
+
+
+// Reads the header and the id list of a segment, but not its payload.
+bool LabelArchive::loadSegment(const QString &filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return false;
+  const QByteArray &header = file.read(SegmentHeaderSize);
+  const uchar *h = reinterpret_cast<const uchar*>(header.constData());
+  if (header.size() != SegmentHeaderSize
+      || std::memcmp(h, SegmentMagic, sizeof(SegmentMagic)) != 0
+      || qFromLittleEndian<quint32>(h + 4) != SegmentVersion) {
+    qWarning() << "LabelArchive::loadSegment() invalid segment" << filename;
+    return false;
+  }
+  Segment segment;
+  segment.filename = filename;
+  segment.minId = qFromLittleEndian<qint64>(h + 16);
+  segment.maxId = qFromLittleEndian<qint64>(h + 24);
+  const int n = int(qFromLittleEndian<quint32>(h + 8));
+  const QByteArray &ids = file.read(qint64(n) * 8);
+  if (ids.size() != n * 8)
+    return false;
+  segment.ids.resize(n);
+  for (int i = 0; i < n; ++i)
+    segment.ids[i] = qFromLittleEndian<qint64>(reinterpret_cast<const uchar*>(ids.constData()) + 8 * i);
+  mSegments.append(segment);
+  return true;
+}
+
+
+// Returns true if one of the segments contains the tweet with the given id.
+bool LabelArchive::sealed(qlonglong id) const
+{
+  foreach (const Segment &segment, mSegments) {
+    if (id < segment.minId || id > segment.maxId)
+      continue;
+    if (std::binary_search(segment.ids.constBegin(), segment.ids.constEnd(), id))
+      return true;
+  }
+  return false;
+}
+
+
+TweetStore LabelArchive::segmentTweets(const Segment &segment) const
+{
+  TweetStore tweets;
+  QFile file(segment.filename);
+  if (file.open(QIODevice::ReadOnly)) {
+    file.seek(SegmentHeaderSize + qint64(segment.ids.count()) * 8);
+    tweets.openData(qUncompress(file.readAll()));
+  }
+  return tweets;
+}
+
+
+QString LabelArchive::segmentNameFilter(const QString &filename)
+{
+  return QFileInfo(filename).completeBaseName() + ".*.seg";
+}
@@ -0,0 +1,81 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __LABELARCHIVE_H_
+#define __LABELARCHIVE_H_
+
+#include <QString>
+#include <QVector>
+#include <QSharedPointer>
+#include <QJsonObject>
+
+#include "tweetstore.h"
+
+
+// Liked or disliked tweets. The most recent labels are kept in a hot
+// TweetStore; older ones are sealed into immutable, qCompress'ed segment
+// files next to it. Each segment starts with its id range and the sorted
+// list of ids it contains, so lookups never decompress a segment unless
+// the tweet itself is requested.
+class LabelArchive
+{
+public:
+  enum { DefaultHotLimit = 2000 };
+
+  LabelArchive(void);
+
+  bool open(const QString &filename);
+  bool save(const QString &filename) const;
+  bool rebase(const QString &filename);
+  bool seal(void);
+  void setHotLimit(int limit);
+  bool project(const TweetProjection &projection);
+
+  int count(void) const;
+  bool isEmpty(void) const;
+  bool contains(qlonglong id) const;
+  bool insert(const QJsonObject &tweet);
+  QJsonObject find(qlonglong id) const;
+  qlonglong mostRecentId(void) const;
+  const TweetStore &hot(void) const;
+  QVector<qlonglong> ids(void) const;
+
+private:
+  struct Segment {
+    QString filename;
+    qlonglong minId;
+    qlonglong maxId;
+    QVector<qlonglong> ids;
+    QSharedPointer<TweetStore> unsaved;
+  };
+
+  bool writeSegment(const Segment &segment) const;
+  bool loadSegment(const QString &filename);
+  bool sealed(qlonglong id) const;
+  TweetStore segmentTweets(const Segment &segment) const;
+  static QString segmentNameFilter(const QString &filename);
+
+  QString mFilename;
+  TweetStore mHot;
+  QVector<Segment> mSegments;
+  int mHotLimit;
+  int mNextSegment;
+};
+
+#endif // __LABELARCHIVE_H_
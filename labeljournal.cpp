@@ -0,0 +1,180 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <algorithm>
+
+#include "labeljournal.h"
+
+
+static const char *OperationNames[] = { "add", "like", "dislike", "remove" };
+
+
+LabelJournal::LabelJournal(void)
+  : mCount(0)
+  , mGeneration(0)
+{
+  /* ... */
+}
+
+
+LabelJournal::~LabelJournal()
+{
+  mFile.close();
+}
+
+
+void LabelJournal::setFileName(const QString &filename)
+{
+  mFile.close();
+  mFile.setFileName(filename);
+  mCount = 0;
+  mGeneration = 0;
+  foreach (int generation, rotatedGenerations())
+    mGeneration = qMax(mGeneration, generation);
+}
+
+
+QString LabelJournal::fileName(void) const
+{
+  return mFile.fileName();
+}
+
+
+// Reads all records not yet covered by a written snapshot: those of the
+// rotated journals in order of their generation, then the active one.
+QList<LabelJournal::Record> LabelJournal::read(void)
+{
+  QList<Record> records;
+  mFile.close();
+  mCount = 0;
+  foreach (int generation, rotatedGenerations())
+    readFile(rotatedFileName(generation), records);
+  mCount = readFile(mFile.fileName(), records);
+  return records;
+}
+
+
+bool LabelJournal::append(Operation op, const QJsonObject &tweet)
+{
+  if (!openForAppend())
+    return false;
+  QJsonObject obj;
+  obj["op"] = QString(OperationNames[op]);
+  obj["tweet"] = tweet;
+  const qint64 bytesWritten = mFile.write(QJsonDocument(obj).toJson(QJsonDocument::Compact) + "\n");
+  mFile.flush();
+  ++mCount;
+  return bytesWritten > 0;
+}
+
+
+// Closes the active journal and renames it to <filename>.<generation>,
+// so that records appended from now on go to a fresh file. The returned
+// generation identifies the snapshot that will include all rotated records.
+int LabelJournal::rotate(void)
+{
+  mFile.close();
+  mCount = 0;
+  ++mGeneration;
+  const QString filename = mFile.fileName();
+  if (mFile.exists() && !mFile.rename(rotatedFileName(mGeneration)))
+    qWarning() << "LabelJournal: cannot rotate" << filename << mFile.errorString();
+  mFile.setFileName(filename);
+  return mGeneration;
+}
+
+
+// Deletes all rotated journals up to `generation` after the snapshot
+// containing their records has been written.
+void LabelJournal::removeRotated(int generation)
+{
+  foreach (int g, rotatedGenerations()) {
+    if (g <= generation)
+      QFile::remove(rotatedFileName(g));
+  }
+}
+
+
+int LabelJournal::count(void) const
+{
+  return mCount;
+}
+
+
+// Parses the records of `filename` into `records`. A trailing line that
+// cannot be parsed (e.g. cut off by a crash) is skipped.
+int LabelJournal::readFile(const QString &filename, QList<Record> &records) const
+{
+  int n = 0;
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return n;
+  while (!file.atEnd()) {
+    const QByteArray &line = file.readLine().trimmed();
+    if (line.isEmpty())
+      continue;
+    const QJsonObject &obj = QJsonDocument::fromJson(line).object();
+    const QString &opName = obj["op"].toString();
+    for (int op = Added; op <= Removed; ++op) {
+      if (opName == OperationNames[op]) {
+        records << Record(Operation(op), obj["tweet"].toObject());
+        ++n;
+        break;
+      }
+    }
+  }
+  return n;
+}
+
+
+QString LabelJournal::rotatedFileName(int generation) const
+{
+  return QString("%1.%2").arg(mFile.fileName()).arg(generation);
+}
+
+
+QList<int> LabelJournal::rotatedGenerations(void) const
+{
+  QList<int> generations;
+  const QFileInfo fi(mFile.fileName());
+  const QStringList &files = fi.dir().entryList(QStringList() << fi.fileName() + ".*", QDir::Files);
+  foreach (QString f, files) {
+    bool ok = false;
+    const int generation = f.mid(fi.fileName().length() + 1).toInt(&ok);
+    if (ok)
+      generations << generation;
+  }
+  std::sort(generations.begin(), generations.end());
+  return generations;
+}
+
+
+bool LabelJournal::openForAppend(void)
+{
+  if (mFile.isOpen())
+    return true;
+  bool ok = mFile.open(QIODevice::WriteOnly | QIODevice::Append);
+  if (!ok)
+    qWarning() << "LabelJournal: cannot open" << mFile.fileName() << mFile.errorString();
+  return ok;
+}
@@ -0,0 +1,68 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __LABELJOURNAL_H_
+#define __LABELJOURNAL_H_
+
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <QJsonObject>
+
+
+class LabelJournal
+{
+public:
+  enum Operation {
+    Added,
+    Liked,
+    Disliked,
+    Removed
+  };
+
+  struct Record {
+    Record(void) : op(Added) { /* ... */ }
+    Record(Operation op, const QJsonObject &tweet) : op(op), tweet(tweet) { /* ... */ }
+    Operation op;
+    QJsonObject tweet;
+  };
+
+  LabelJournal(void);
+  ~LabelJournal();
+
+  void setFileName(const QString &filename);
+  QString fileName(void) const;
+  QList<Record> read(void);
+  bool append(Operation op, const QJsonObject &tweet);
+  int rotate(void);
+  void removeRotated(int generation);
+  int count(void) const;
+
+private:
+  bool openForAppend(void);
+  int readFile(const QString &filename, QList<Record> &records) const;
+  QString rotatedFileName(int generation) const;
+  QList<int> rotatedGenerations(void) const;
+
+  QFile mFile;
+  int mCount;
+  int mGeneration;
+};
+
+#endif // __LABELJOURNAL_H_
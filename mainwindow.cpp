@@ -30,6 +30,8 @@
 #include <QJsonObject>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QPoint>
 #include <QGraphicsOpacityEffect>
 #include <QEasingCurve>
@@ -38,20 +40,44 @@
 #include <QTimer>
 #include <QVector>
 #include <QShortcut>
+#include <QHeaderView>
 #include <QLabel>
 #include <QRegExp>
 #include <QNetworkDiskCache>
 #include <QSettings>
-#include <QPixmapCache>
+#include <QSet>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QThread>
+#include <QImage>
+#include <QPushButton>
 #include <qmath.h>
 
 #include "globals.h"
 #include "mainwindow.h"
-#include "flowlayout.h"
+#include "tokenstrip.h"
+#include "frameclock.h"
+#include "framestats.h"
+#include "labeljournal.h"
+#include "tweetstore.h"
+#include "labelarchive.h"
+#include "snapshotwriter.h"
+#include "metrics.h"
+#include "tweet.h"
+#include "tweetprojection.h"
+#include "timelinebackfill.h"
+#include "ingestdriver.h"
+#include "refreshscheduler.h"
+#include "avatarfetcher.h"
+#include "thumbnailcache.h"
+#include "avatarcache.h"
+#include "tweettablemodel.h"
 #include "ui_mainwindow.h"
 
 #include "o1twitter.h"
-#include "o1requestor.h"
 #include "o2globals.h"
 #include "o2settingsstore.h"
 
@@ -62,6 +88,16 @@ struct KineticData {
     int t;
 };
 
+// A tweet card prepared ahead of time: words measured and laid out in
+// an off-screen token strip, avatar looked up or requested.
+struct Card {
+  Card(void) : id(0), strip(Q_NULLPTR) { /* ... */ }
+  qlonglong id;
+  Tweet tweet;
+  QPixmap avatar;
+  TokenStrip *strip;
+};
+
 QDebug operator<<(QDebug debug, const KineticData &kd)
 {
   QDebugStateSaver saver(debug);
@@ -76,9 +112,139 @@ auto wordComparator = [](const QString &a, const QString &b) {
 };
 
 
-auto idComparator = [](const QVariant &a, const QVariant &b) {
-  return a.toMap()["id"].toLongLong() > b.toMap()["id"].toLongLong();
-};
+// If the binary store `filename` doesn't exist yet, imports the JSON
+// file of the same base name written by earlier versions.
+static void importLegacyTweets(const QString &filename)
+{
+  if (!QFile::exists(TweetStore::currentFile(filename))) {
+    const QFileInfo fi(filename);
+    const QString &jsonFilename = fi.path() + "/" + fi.completeBaseName() + ".json";
+    if (QFile::exists(jsonFilename))
+      TweetStore::importJson(jsonFilename, filename);
+  }
+}
+
+
+// Moves the unreadable store `filename` aside, so that the JSON file of
+// earlier versions is imported in its place, if there is one.
+static void discardStore(const QString &filename)
+{
+  const QString &current = TweetStore::currentFile(filename);
+  const QString &badFilename = current + ".bad";
+  qWarning() << "moving unreadable store" << current << "to" << badFilename;
+  Metrics::add("storage/unreadable");
+  QFile::remove(badFilename);
+  QFile::rename(current, badFilename);
+  importLegacyTweets(filename);
+}
+
+
+// Returns the size of the store `filename` including its segments.
+static qint64 storeSize(const QString &filename)
+{
+  const QFileInfo fi(filename);
+  qint64 size = QFileInfo(TweetStore::currentFile(filename)).size();
+  const QFileInfoList &segments = fi.dir().entryInfoList(QStringList() << fi.completeBaseName() + ".*.seg", QDir::Files);
+  foreach (QFileInfo segment, segments)
+    size += segment.size();
+  return size;
+}
+
+
+static void reportMigration(const QString &filename, qint64 before)
+{
+  const qint64 after = storeSize(filename);
+  Metrics::add("migration/bytesBefore", before);
+  Metrics::add("migration/bytesAfter", after);
+  qDebug() << "projected" << filename << before << "->" << after << "bytes";
+}
+
+
+// With `migrate` set, existing tweets are reduced to the fields of
+// `projection` once before the store is opened.
+static TweetStore loadTweetStore(const QString &filename, const TweetProjection &projection, bool migrate)
+{
+  TweetStore store;
+  importLegacyTweets(filename);
+  if (!store.open(TweetStore::currentFile(filename)) && QFile::exists(TweetStore::currentFile(filename))) {
+    discardStore(filename);
+    store.open(TweetStore::currentFile(filename));
+  }
+  if (migrate && QFile::exists(TweetStore::currentFile(filename))) {
+    const qint64 before = storeSize(filename);
+    const TweetStore &projected = store.projected(projection);
+    store.clear();
+    projected.save(TweetStore::nextFile(filename));
+    TweetStore::removeStaleFiles(filename);
+    reportMigration(filename, before);
+    store.open(TweetStore::currentFile(filename));
+  }
+  return store;
+}
+
+
+static LabelArchive loadLabelArchive(const QString &filename, int hotLimit, const TweetProjection &projection, bool migrate)
+{
+  LabelArchive archive;
+  importLegacyTweets(filename);
+  archive.setHotLimit(hotLimit);
+  if (!archive.open(filename) && QFile::exists(TweetStore::currentFile(filename))) {
+    discardStore(filename);
+    archive.open(filename);
+  }
+  if (migrate && QFile::exists(TweetStore::currentFile(filename))) {
+    const qint64 before = storeSize(filename);
+    archive.project(projection);
+    archive.save(TweetStore::nextFile(filename));
+    archive.rebase(TweetStore::currentFile(filename));
+    TweetStore::removeStaleFiles(filename);
+    reportMigration(filename, before);
+  }
+  return archive;
+}
+
+
+// Runs on the decoder pool, so that the GUI thread only has to turn the
+// small result into a pixmap. The result is kept in `thumbnails` for
+// the next start.
+static QImage decodeAvatar(const ThumbnailCache &thumbnails, const QUrl &url, const QByteArray &data, int size)
+{
+  QElapsedTimer t;
+  t.start();
+  QImage image;
+  image.loadFromData(data);
+  if (!image.isNull() && (image.width() > size || image.height() > size))
+    image = image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+  Metrics::add("avatars/decoded");
+  Metrics::add("avatars/decodeNs", t.nsecsElapsed());
+  thumbnails.store(url, image);
+  return image;
+}
+
+
+static QStringList loadWordList(const QString &filename)
+{
+  QStringList words;
+  QFile wordList(filename);
+  if (wordList.open(QIODevice::ReadOnly)) {
+    while (!wordList.atEnd()) {
+      QString word = QString::fromUtf8(wordList.readLine());
+      words << word.trimmed();
+    }
+    wordList.close();
+    qSort(words.begin(), words.end(), wordComparator);
+  }
+  return words;
+}
+
+
+// Adds the hot tweets of `src` to `dst`, e.g. labels given while `dst`
+// was still being loaded.
+static void mergeLabels(LabelArchive &dst, const LabelArchive &src)
+{
+  for (int i = 0; i < src.hot().count(); ++i)
+    dst.insert(src.hot().at(i));
+}
 
 
 
@@ -86,12 +252,12 @@ static const int MaxKineticDataSamples = 5;
 static const qreal Friction = 0.95;
 static const int TimeInterval = 25;
 static const int AnimationDuration = 200;
-enum ColumnIndexes {
-  ColumnProfileImage = 0,
-  ColumnText,
-  ColumnCreatedAt,
-  ColumnId
-};
+static const int DefaultJournalCompactionThreshold = 1000;
+static const int DefaultSnapshotDelay = 2000;
+static const int DefaultShutdownTimeout = 3000;
+static const int DefaultWatermarkDelay = 1000;
+static const int AvatarSize = 48;
+static const int DefaultCardLookAhead = 3;
 
 class MainWindowPrivate
 {
@@ -102,13 +268,33 @@ public:
     , settings(QSettings::IniFormat, QSettings::UserScope, AppCompanyName, AppName)
     , tweetNAM(parent)
     , imageNAM(parent)
-    , reply(Q_NULLPTR)
+    , backfill(Q_NULLPTR)
+    , ingestDriver(Q_NULLPTR)
+    , scheduler(Q_NULLPTR)
+    , avatarFetcher(Q_NULLPTR)
+    , tableModel(Q_NULLPTR)
+    , tokenStrip(Q_NULLPTR)
+    , cardLookAhead(DefaultCardLookAhead)
+    , measureBaselineCards(false)
+    , cardsScheduled(false)
+    , avatarColumnResizeScheduled(false)
+    , avatarDecodesPending(0)
+    , manualRefresh(false)
+    , refreshFailed(false)
+    , refreshFailStatus(0)
     , tableBuildCalled(false)
+    , pendingLoads(0)
+    , storesLoaded(false)
+    , firstTweetShown(false)
     , tweetFilepath(QStandardPaths::writableLocation(QStandardPaths::DataLocation))
+    , migrateProjection(false)
+    , snapshotWriter(Q_NULLPTR)
+    , shutdownTimeout(DefaultShutdownTimeout)
     , mostRecentId(0)
     , mouseDown(false)
     , tweetFrameOpacityEffect(Q_NULLPTR)
-    , mouseMoveTimerId(0)
+    , frameClock(Q_NULLPTR)
+    , swipePending(false)
     , imageCache(new QNetworkDiskCache(parent))
   {
     store->setGroupKey("twitter");
@@ -131,7 +317,13 @@ public:
   }
   ~MainWindowPrivate()
   {
-    /* ... */
+    // closeEvent() has waited for the writer already. If it is still busy,
+    // it is abandoned rather than waited for without limit: the journal
+    // covers what it has not written.
+    if (snapshotWriter == Q_NULLPTR || snapshotWriter->shutdown(shutdownTimeout))
+      delete snapshotWriter;
+    else
+      qWarning() << "MainWindowPrivate: abandoning snapshot writer";
   }
 
   QVector<KineticData> kineticData;
@@ -140,26 +332,70 @@ public:
   QSettings settings;
   QNetworkAccessManager tweetNAM;
   QNetworkAccessManager imageNAM;
-  QNetworkReply *reply;
+  TimelineBackfill *backfill;
+  IngestDriver *ingestDriver;
+  RefreshScheduler *scheduler;
+  AvatarFetcher *avatarFetcher;
+  TweetTableModel *tableModel;
+  TokenStrip *tokenStrip;
+  QList<Card> cards;
+  QList<TokenStrip*> spareStrips;
+  int cardLookAhead;
+  bool measureBaselineCards;
+  bool cardsScheduled;
+  bool avatarColumnResizeScheduled;
+  QThreadPool decoderPool;
+  QHash<QFutureWatcher<QImage>*, QUrl> avatarDecodes;
+  int avatarDecodesPending;
+  AvatarCache avatarCache;
+  ThumbnailCache thumbnails;
+  bool manualRefresh;
+  bool refreshFailed;
+  int refreshFailStatus; // first failure of the refresh
+  QString refreshFailError;
+  QByteArray refreshFailBody;
+  QElapsedTimer refreshTimer;
   bool tableBuildCalled;
+  int pendingLoads;
+  bool storesLoaded;
+  bool firstTweetShown;
+  QElapsedTimer startupTimer;
+  QFutureWatcher<TweetStore> storedTweetsWatcher;
+  QFutureWatcher<LabelArchive> badTweetsWatcher;
+  QFutureWatcher<LabelArchive> goodTweetsWatcher;
+  QFutureWatcher<QStringList> wordListWatcher;
+  QList<LabelJournal::Record> journalLabels;
+  QSet<qlonglong> knownIds;
   QString tweetFilepath;
   QString tweetFilename;
   QString badTweetFilename;
   QString goodTweetFilename;
   QString wordListFilename;
-  QJsonArray storedTweets;
-  QJsonArray badTweets;
-  QJsonArray goodTweets;
+  QString mostRecentIdFilename;
+  TweetProjection projection;
+  bool migrateProjection;
+  LabelJournal journal;
+  TweetStore storedTweets;
+  LabelArchive badTweets;
+  LabelArchive goodTweets;
+  SnapshotWriter *snapshotWriter;
+  int shutdownTimeout;
   qlonglong mostRecentId;
+  QTimer watermarkTimer;
   QPoint originalTweetFramePos;
   QPoint lastTweetFramePos;
   QPoint lastMousePos;
   bool mouseDown;
   QGraphicsOpacityEffect *tweetFrameOpacityEffect;
   QTime mouseMoveTimer;
-  int mouseMoveTimerId;
+  FrameClock *frameClock;
+  FrameStats frameStats;
+  QString frameDumpFilename;
+  bool swipePending;
   QPointF velocity;
+  QPointF flingRemainder;
   QJsonValue currentTweet;
+  Tweet currentCard; // the decoded fields of currentTweet
   QPropertyAnimation unfloatAnimation;
   QPropertyAnimation floatInAnimation;
   QPropertyAnimation floatOutAnimation;
@@ -176,48 +412,48 @@ MainWindow::MainWindow(QWidget *parent)
   , d_ptr(new MainWindowPrivate(this))
 {
   Q_D(MainWindow);
+  d->startupTimer.start();
   ui->setupUi(this);
 
+  if (d->settings.value("mock/enabled", false).toBool()) {
+    d->ingestDriver = new IngestDriver(d->settings, this);
+    d->ingestDriver->listen();
+    // keep synthetic tweets away from the real stores
+    d->tweetFilepath += "/mock";
+  }
+
   qDebug() << d->tweetFilepath;
 
-  d->tweetFilename = d->tweetFilepath + "/all_tweets_of_" + d->settings.value("twitter/userId").toString() + ".json";
-  d->badTweetFilename = d->tweetFilepath + "/bad_tweets_of_" + d->settings.value("twitter/userId").toString() + ".json";
-  d->goodTweetFilename = d->tweetFilepath + "/good_tweets_of_" + d->settings.value("twitter/userId").toString() + ".json";
+  d->tweetFilename = d->tweetFilepath + "/all_tweets_of_" + d->settings.value("twitter/userId").toString() + ".tws";
+  d->badTweetFilename = d->tweetFilepath + "/bad_tweets_of_" + d->settings.value("twitter/userId").toString() + ".tws";
+  d->goodTweetFilename = d->tweetFilepath + "/good_tweets_of_" + d->settings.value("twitter/userId").toString() + ".tws";
   d->wordListFilename = d->tweetFilepath + "/relevant_words_of_" + d->settings.value("twitter/userId").toString() + ".txt";
-
-  bool ok;
-
-  ok = QDir().mkpath(d->tweetFilepath);
-
-  QFile tweetFile(d->tweetFilename);
-  ok = tweetFile.open(QIODevice::ReadOnly);
-  if (ok) {
-    d->storedTweets = QJsonDocument::fromJson(tweetFile.readAll()).array();
-    tweetFile.close();
-  }
-  QFile badTweetsFile(d->badTweetFilename);
-  ok = badTweetsFile.open(QIODevice::ReadOnly);
-  if (ok) {
-    d->badTweets = QJsonDocument::fromJson(badTweetsFile.readAll()).array();
-    badTweetsFile.close();
-  }
-  QFile goodTweets(d->goodTweetFilename);
-  ok = goodTweets.open(QIODevice::ReadOnly);
-  if (ok) {
-    d->goodTweets = QJsonDocument::fromJson(goodTweets.readAll()).array();
-    goodTweets.close();
-  }
-  QFile wordList(d->wordListFilename);
-  ok = wordList.open(QIODevice::ReadOnly);
-  if (ok) {
-    while (!wordList.atEnd()) {
-      QString word = QString::fromUtf8(wordList.readLine());
-      d->relevantWords << word.trimmed();
+  d->mostRecentIdFilename = d->tweetFilepath + "/most_recent_id_of_" + d->settings.value("twitter/userId").toString() + ".txt";
+  d->projection = TweetProjection(d->settings.value("storage/fieldWhitelist", TweetProjection::defaultFields()).toStringList());
+  d->migrateProjection = !d->settings.value("storage/fieldsProjected", false).toBool();
+
+  QDir().mkpath(d->tweetFilepath);
+
+  // the watermark, followed by the gaps below it still to be fetched,
+  // one "since_id max_id" pair per line
+  QList<TimelineBackfill::Range> openGaps;
+  QFile mostRecentIdFile(d->mostRecentIdFilename);
+  if (mostRecentIdFile.open(QIODevice::ReadOnly)) {
+    const QList<QByteArray> &lines = mostRecentIdFile.readAll().trimmed().split('\n');
+    d->mostRecentId = lines.first().trimmed().toLongLong();
+    for (int i = 1; i < lines.count(); ++i) {
+      const QList<QByteArray> &ids = lines.at(i).simplified().split(' ');
+      if (ids.count() == 2)
+        openGaps.append(TimelineBackfill::Range(ids.at(0).toLongLong(), ids.at(1).toLongLong()));
     }
-    wordList.close();
-    qSort(d->relevantWords.begin(), d->relevantWords.end(), wordComparator);
+    mostRecentIdFile.close();
   }
 
+  d->journal.setFileName(d->tweetFilepath + "/journal_of_" + d->settings.value("twitter/userId").toString() + ".jsonl");
+  d->snapshotWriter = new SnapshotWriter(d->tweetFilename, d->goodTweetFilename, d->badTweetFilename);
+  d->snapshotWriter->setDelay(d->settings.value("storage/snapshotDelay", DefaultSnapshotDelay).toInt());
+  QObject::connect(d->snapshotWriter, SIGNAL(written(int,bool)), SLOT(onSnapshotWritten(int,bool)));
+
   QObject::connect(d->oauth, SIGNAL(linkedChanged()), SLOT(onLinkedChanged()));
   QObject::connect(d->oauth, SIGNAL(linkingFailed()), SLOT(onLinkingFailed()));
   QObject::connect(d->oauth, SIGNAL(linkingSucceeded()), SLOT(onLinkingSucceeded()));
@@ -227,33 +463,85 @@ MainWindow::MainWindow(QWidget *parent)
   QObject::connect(ui->dislikeButton, SIGNAL(clicked(bool)), SLOT(dislike()));
   QObject::connect(ui->actionExit, SIGNAL(triggered(bool)), SLOT(close()));
   QObject::connect(ui->actionRefresh, SIGNAL(triggered(bool)), SLOT(onRefresh()));
+  QObject::connect(ui->actionDiagnostics, SIGNAL(triggered(bool)), SLOT(onDiagnostics()));
   ui->tweetFrame->installEventFilter(this);
   d->tweetFrameOpacityEffect = new QGraphicsOpacityEffect(ui->tweetFrame);
   d->tweetFrameOpacityEffect->setOpacity(1.0);
   ui->tweetFrame->setGraphicsEffect(d->tweetFrameOpacityEffect);
   d->floatOutAnimation.setTargetObject(ui->tweetFrame);
+  // the next card takes the place of the old one as soon as it is off screen
+  QObject::connect(&d->floatOutAnimation, &QAbstractAnimation::finished, this, &MainWindow::pickNextTweet);
   d->floatInAnimation.setTargetObject(ui->tweetFrame);
   d->unfloatAnimation.setTargetObject(ui->tweetFrame);
 
+  d->frameClock = new FrameClock(this);
+  QObject::connect(d->frameClock, SIGNAL(frame(qint64)), SLOT(onFrame(qint64)));
+  d->frameStats.setFrameInterval(qint64(FrameClock::IntervalMs) * 1000000);
+  d->frameDumpFilename = d->settings.value("frames/dumpFile").toString();
+
+  d->tokenStrip = newTokenStrip();
+  ui->tweetFrameLayout->addWidget(d->tokenStrip);
+  d->tokenStrip->show();
+  d->cardLookAhead = qMax(0, d->settings.value("cards/lookAhead", DefaultCardLookAhead).toInt());
+  d->measureBaselineCards = d->settings.value("cards/measureBaseline", false).toBool();
+
   ui->likeButton->stackUnder(ui->tweetFrame);
   ui->dislikeButton->stackUnder(ui->tweetFrame);
 
-  QObject::connect(&d->tweetNAM, SIGNAL(finished(QNetworkReply*)), this, SLOT(gotUserTimeline(QNetworkReply*)));
-  QObject::connect(&d->imageNAM, SIGNAL(finished(QNetworkReply*)), this, SLOT(gotImage(QNetworkReply*)));
-
-  ui->tableWidget->verticalHeader()->hide();
-  ui->tableWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-  ui->tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-  QObject::connect(ui->tableWidget, SIGNAL(customContextMenuRequested(QPoint)), SLOT(onCustomMenuRequested(QPoint)));
-  d->tableContextMenu = new QMenu(ui->tableWidget);
+  d->backfill = new TimelineBackfill(&d->tweetNAM, d->oauth, this);
+  d->backfill->setMaxInFlight(d->settings.value("backfill/maxInFlight", TimelineBackfill::DefaultMaxInFlight).toInt());
+  d->backfill->setMaxPages(d->ingestDriver != Q_NULLPTR && d->ingestDriver->maxPages() > 0
+                           ? d->ingestDriver->maxPages()
+                           : d->settings.value("backfill/maxPages", TimelineBackfill::DefaultMaxPages).toInt());
+  d->backfill->setOpenGaps(openGaps);
+  d->watermarkTimer.setSingleShot(true);
+  d->watermarkTimer.setInterval(d->settings.value("storage/watermarkDelay", DefaultWatermarkDelay).toInt());
+  QObject::connect(&d->watermarkTimer, SIGNAL(timeout()), SLOT(saveWatermark()));
+  QObject::connect(d->backfill, SIGNAL(gapsChanged()), SLOT(scheduleWatermark()));
+  QObject::connect(d->backfill, SIGNAL(pageReceived(QJsonArray)), SLOT(gotUserTimeline(QJsonArray)));
+  QObject::connect(d->backfill, SIGNAL(failed(int,QString,QByteArray)), SLOT(onTimelineFailed(int,QString,QByteArray)));
+  QObject::connect(d->backfill, SIGNAL(finished(int,int)), SLOT(onBackfillFinished(int,int)));
+  d->scheduler = new RefreshScheduler(this);
+  d->scheduler->setIntervals(d->settings.value("scheduler/minInterval", RefreshScheduler::DefaultMinInterval).toInt(),
+                             d->settings.value("scheduler/maxInterval", RefreshScheduler::DefaultMaxInterval).toInt());
+  d->scheduler->setDefaultInterval(d->settings.value("scheduler/defaultInterval", RefreshScheduler::DefaultInterval).toInt());
+  d->scheduler->setTargetTweets(d->settings.value("scheduler/targetTweets", RefreshScheduler::DefaultTargetTweets).toInt());
+  QObject::connect(d->backfill, SIGNAL(rateLimitUpdated(int,int,qint64)), d->scheduler, SLOT(rateLimitUpdated(int,int,qint64)));
+  QObject::connect(d->scheduler, SIGNAL(pollDue()), SLOT(onScheduledRefresh()));
+  if (d->ingestDriver != Q_NULLPTR)
+    d->backfill->setBaseUrl(d->ingestDriver->baseUrl());
+  d->avatarFetcher = new AvatarFetcher(&d->imageNAM, this);
+  d->avatarFetcher->setMaxConcurrent(d->settings.value("avatars/maxConcurrent", AvatarFetcher::DefaultMaxConcurrent).toInt());
+  QObject::connect(d->avatarFetcher, SIGNAL(fetched(QUrl,QByteArray)), SLOT(gotImage(QUrl,QByteArray)));
+  d->avatarCache.setMaxBytes(d->settings.value("avatars/cacheBytes", AvatarCache::DefaultMaxBytes).toLongLong());
+  d->thumbnails = ThumbnailCache(d->tweetFilepath + "/thumbnails");
+  QtConcurrent::run(d->thumbnails, &ThumbnailCache::evict,
+                    d->settings.value("thumbnails/maxBytes", ThumbnailCache::DefaultMaxBytes).toLongLong(),
+                    d->settings.value("thumbnails/maxAgeDays", ThumbnailCache::DefaultMaxAgeDays).toInt());
+  d->decoderPool.setMaxThreadCount(d->settings.value("avatars/decoderThreads", qMax(1, QThread::idealThreadCount() / 2)).toInt());
+
+  d->tableModel = new TweetTableModel(&d->storedTweets, &d->avatarCache, this);
+  QObject::connect(d->tableModel, SIGNAL(avatarNeeded(QUrl)), SLOT(loadImage(QUrl)), Qt::QueuedConnection);
+  QObject::connect(d->avatarFetcher, SIGNAL(failed(QUrl)), d->tableModel, SLOT(avatarFailed(QUrl)));
+  ui->tableView->setModel(d->tableModel);
+  ui->tableView->verticalHeader()->hide();
+  // rows of one fixed height, so that inserting or removing rows never
+  // makes the view measure other rows
+  ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  ui->tableView->verticalHeader()->setDefaultSectionSize(AvatarSize);
+  ui->tableView->setContextMenuPolicy(Qt::CustomContextMenu);
+  ui->tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+  QObject::connect(ui->tableView, SIGNAL(customContextMenuRequested(QPoint)), SLOT(onCustomMenuRequested(QPoint)));
+  d->tableContextMenu = new QMenu(ui->tableView);
   d->tableContextMenu->addAction(tr("Delete"), this, SLOT(onDeleteTweet()));
   d->tableContextMenu->addAction(tr("Evaluate"), this, SLOT(onEvaluateTweet()));
 
   restoreSettings();
 
-  d->oauth->link();
+  if (d->ingestDriver == Q_NULLPTR)
+    d->oauth->link();
 
-  QTimer::singleShot(100, this, SLOT(buildTable()));
+  loadStores();
 }
 
 
@@ -276,21 +564,23 @@ void MainWindow::closeEvent(QCloseEvent*)
 
   stopMotion();
   saveSettings();
-
-  QFile tweetFile(d->tweetFilename);
-  tweetFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-  tweetFile.write(QJsonDocument(d->storedTweets).toJson(QJsonDocument::Indented));
-  tweetFile.close();
-
-  QFile badTweetFile(d->badTweetFilename);
-  badTweetFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-  badTweetFile.write(QJsonDocument(d->badTweets).toJson(QJsonDocument::Indented));
-  badTweetFile.close();
-
-  QFile goodTweetFile(d->goodTweetFilename);
-  goodTweetFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-  goodTweetFile.write(QJsonDocument(d->goodTweets).toJson(QJsonDocument::Indented));
-  goodTweetFile.close();
+  if (d->watermarkTimer.isActive()) {
+    d->watermarkTimer.stop();
+    saveWatermark();
+  }
+  if (!d->frameDumpFilename.isEmpty() && !d->frameStats.save(d->frameDumpFilename))
+    qWarning() << "MainWindow::closeEvent() cannot write" << d->frameDumpFilename;
+  d->shutdownTimeout = d->settings.value("storage/shutdownTimeout", DefaultShutdownTimeout).toInt();
+  if (!d->storesLoaded)
+    return;
+  maybeCompactJournal();
+  const int timeout = d->shutdownTimeout;
+  if (d->snapshotWriter->shutdown(timeout)) {
+    d->journal.removeRotated(d->snapshotWriter->lastWrittenGeneration());
+  }
+  else {
+    qWarning() << "MainWindow::closeEvent() snapshot not written within" << timeout << "ms; journal will be replayed on next start";
+  }
 
   QFile wordFile(d->wordListFilename);
   wordFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
@@ -302,13 +592,23 @@ void MainWindow::closeEvent(QCloseEvent*)
 }
 
 
-void MainWindow::timerEvent(QTimerEvent *e)
+// Advances the fling by the time elapsed since the previous frame, so
+// that its speed does not depend on the frame rate. The velocity is given
+// in pixels per TimeInterval, and Friction applies once per TimeInterval.
+// The clock stops when neither the fling nor any card animation of the
+// swipe is running any more.
+void MainWindow::onFrame(qint64 intervalNs)
 {
   Q_D(MainWindow);
-  if (e->timerId() == d->mouseMoveTimerId) {
+  d->frameStats.addFrame(intervalNs);
+  if (!d->velocity.isNull()) {
     if (d->velocity.manhattanLength() > M_SQRT2) {
-      scrollBy(d->velocity.toPoint());
-      d->velocity *= Friction;
+      const qreal periods = intervalNs / (TimeInterval * 1e6);
+      d->flingRemainder += d->velocity * periods;
+      const QPoint &step = d->flingRemainder.toPoint();
+      d->flingRemainder -= step;
+      scrollBy(step);
+      d->velocity *= qPow(Friction, periods);
     }
     else {
       stopMotion();
@@ -316,6 +616,14 @@ void MainWindow::timerEvent(QTimerEvent *e)
         unfloatTweet();
     }
   }
+  if (d->velocity.isNull()
+      && !d->swipePending
+      && d->floatInAnimation.state() != QAbstractAnimation::Running
+      && d->floatOutAnimation.state() != QAbstractAnimation::Running
+      && d->unfloatAnimation.state() != QAbstractAnimation::Running) {
+    d->frameClock->stop();
+    d->frameStats.end();
+  }
 }
 
 
@@ -326,6 +634,7 @@ void MainWindow::unfloatTweet(void)
   d->unfloatAnimation.setEndValue(d->originalTweetFramePos);
   d->unfloatAnimation.start();
   d->tweetFrameOpacityEffect->setOpacity(1.0);
+  trackFrames();
 }
 
 
@@ -334,22 +643,29 @@ void MainWindow::startMotion(const QPointF &velocity)
   Q_D(MainWindow);
   d->lastTweetFramePos = ui->tweetFrame->pos();
   d->velocity = velocity;
-  if (d->mouseMoveTimerId == 0)
-    d->mouseMoveTimerId = startTimer(TimeInterval);
+  d->flingRemainder = QPointF();
+  trackFrames();
 }
 
 
 void MainWindow::stopMotion(void)
 {
   Q_D(MainWindow);
-  if (d->mouseMoveTimerId) {
-    killTimer(d->mouseMoveTimerId);
-    d->mouseMoveTimerId = 0;
-  }
   d->velocity = QPointF();
 }
 
 
+// Starts recording the frames of a swipe unless one is being recorded.
+void MainWindow::trackFrames(void)
+{
+  Q_D(MainWindow);
+  if (d->frameClock->state() == QAbstractAnimation::Running)
+    return;
+  d->frameStats.begin();
+  d->frameClock->start();
+}
+
+
 int MainWindow::likeLimit(void) const
 {
   return ui->tweetFrame->width();
@@ -498,52 +814,292 @@ void MainWindow::onCloseBrowser(void)
 }
 
 
-QJsonArray MainWindow::mergeTweets(const QJsonArray &storedJson, const QJsonArray &currentJson)
+// Loads the tweet stores and the word list on the global thread pool.
+// The queue is published as soon as it is available, so the first tweet
+// can be rated while the labeled tweets are still loading.
+void MainWindow::loadStores(void)
 {
-  const QList<QVariant> &currentList = currentJson.toVariantList();
-  const QList<QVariant> &storedList = storedJson.toVariantList();
-  QList<QVariant> result = storedList;
-  foreach (QVariant post, currentList) {
-    QList<QVariant>::const_iterator idx;
-    idx = qBinaryFind(storedList.constBegin(), storedList.constEnd(), post, idComparator);
-    if (idx == storedList.constEnd()) {
-      result << post;
-    }
+  Q_D(MainWindow);
+  ui->actionRefresh->setEnabled(false);
+  d->pendingLoads = 4;
+  QObject::connect(&d->storedTweetsWatcher, SIGNAL(finished()), SLOT(onStoredTweetsLoaded()));
+  QObject::connect(&d->goodTweetsWatcher, SIGNAL(finished()), SLOT(onLabeledTweetsLoaded()));
+  QObject::connect(&d->badTweetsWatcher, SIGNAL(finished()), SLOT(onLabeledTweetsLoaded()));
+  QObject::connect(&d->wordListWatcher, SIGNAL(finished()), SLOT(onWordListLoaded()));
+  d->storedTweetsWatcher.setFuture(QtConcurrent::run(loadTweetStore, d->tweetFilename, d->projection, d->migrateProjection));
+  const int hotLimit = d->settings.value("storage/hotLabelLimit", LabelArchive::DefaultHotLimit).toInt();
+  d->goodTweetsWatcher.setFuture(QtConcurrent::run(loadLabelArchive, d->goodTweetFilename, hotLimit, d->projection, d->migrateProjection));
+  d->badTweetsWatcher.setFuture(QtConcurrent::run(loadLabelArchive, d->badTweetFilename, hotLimit, d->projection, d->migrateProjection));
+  d->wordListWatcher.setFuture(QtConcurrent::run(loadWordList, d->wordListFilename));
+}
+
+
+void MainWindow::onStoredTweetsLoaded(void)
+{
+  Q_D(MainWindow);
+  d->storedTweets = d->storedTweetsWatcher.result();
+  replayJournal();
+  d->tableModel->reset();
+  qDebug() << "MainWindow::onStoredTweetsLoaded()" << d->storedTweets.count() << "tweets after" << d->startupTimer.elapsed() << "ms";
+  if (!d->storedTweets.isEmpty())
+    buildTable();
+  onLoadFinished();
+}
+
+
+void MainWindow::onLabeledTweetsLoaded(void)
+{
+  Q_D(MainWindow);
+  if (sender() == &d->goodTweetsWatcher) {
+    LabelArchive goodTweets = d->goodTweetsWatcher.result();
+    mergeLabels(goodTweets, d->goodTweets);
+    d->goodTweets = goodTweets;
+  }
+  else {
+    LabelArchive badTweets = d->badTweetsWatcher.result();
+    mergeLabels(badTweets, d->badTweets);
+    d->badTweets = badTweets;
+  }
+  onLoadFinished();
+}
+
+
+void MainWindow::onWordListLoaded(void)
+{
+  Q_D(MainWindow);
+  QStringList words = d->wordListWatcher.result();
+  QStringList addedWords;
+  foreach (QString word, d->relevantWords) {
+    if (qBinaryFind(words.constBegin(), words.constEnd(), word, wordComparator) == words.constEnd())
+      addedWords << word;
+  }
+  words << addedWords;
+  qSort(words.begin(), words.end(), wordComparator);
+  d->relevantWords = words;
+  onLoadFinished();
+}
+
+
+void MainWindow::onLoadFinished(void)
+{
+  Q_D(MainWindow);
+  if (--d->pendingLoads > 0)
+    return;
+  d->storesLoaded = true;
+  applyJournalLabels();
+  buildIdIndex();
+  maybeCompactJournal();
+  ui->actionRefresh->setEnabled(true);
+  qDebug() << "MainWindow::onLoadFinished() after" << d->startupTimer.elapsed() << "ms";
+  if (d->migrateProjection) {
+    d->migrateProjection = false;
+    d->settings.setValue("storage/fieldsProjected", true);
+    ui->statusBar->showMessage(tr("Shrunk tweet stores from %1 to %2 bytes")
+                               .arg(Metrics::value("migration/bytesBefore"))
+                               .arg(Metrics::value("migration/bytesAfter")), 5000);
   }
-  qSort(result.begin(), result.end(), idComparator);
-  return QJsonArray::fromVariantList(result);
+  if (!d->storedTweets.isEmpty())
+    advanceMostRecentId(d->storedTweets.idAt(0));
+  advanceMostRecentId(d->goodTweets.mostRecentId());
+  advanceMostRecentId(d->badTweets.mostRecentId());
+  if (!d->tableBuildCalled)
+    buildTable();
+  if (d->settings.value("scheduler/enabled", true).toBool())
+    d->scheduler->start();
+  if (d->ingestDriver != Q_NULLPTR && !d->backfill->isRunning() && d->ingestDriver->takeRefresh())
+    getUserTimeline();
+}
+
+
+// Collects the ids of all queued and labeled tweets, so that mergeTweets()
+// can tell new tweets from known ones without touching the stores.
+void MainWindow::buildIdIndex(void)
+{
+  Q_D(MainWindow);
+  const QVector<qlonglong> &goodIds = d->goodTweets.ids();
+  const QVector<qlonglong> &badIds = d->badTweets.ids();
+  d->knownIds.clear();
+  d->knownIds.reserve(d->storedTweets.count() + goodIds.count() + badIds.count() + 1);
+  for (int i = 0; i < d->storedTweets.count(); ++i)
+    d->knownIds.insert(d->storedTweets.idAt(i));
+  foreach (qlonglong id, goodIds)
+    d->knownIds.insert(id);
+  foreach (qlonglong id, badIds)
+    d->knownIds.insert(id);
+  if (d->currentTweet.isObject())
+    d->knownIds.insert(TweetStore::tweetId(d->currentTweet.toObject()));
 }
 
 
-void MainWindow::calculateMostRecentId(void)
+// Queues and journals those of `tweets` that have been neither queued nor
+// labeled before. Each of the k tweets costs one lookup in the id index;
+// inserting them into the queue costs O(k log n). Returns the number of
+// tweets added.
+int MainWindow::mergeTweets(const QJsonArray &tweets)
 {
   Q_D(MainWindow);
-  qlonglong lastMostRecentId = d->mostRecentId;
-  d->mostRecentId = d->currentTweet.toVariant().toMap()["id"].toLongLong();
-  if (!d->storedTweets.isEmpty()) {
-    qlonglong id = d->storedTweets.first().toVariant().toMap()["id"].toLongLong();
-    d->mostRecentId = qMax(id, d->mostRecentId);
+  QJsonArray fresh;
+  qlonglong maxId = 0;
+  foreach (QJsonValue value, tweets) {
+    const QJsonObject &tweet = value.toObject();
+    const qlonglong id = TweetStore::tweetId(tweet);
+    if (id == 0 || d->knownIds.contains(id))
+      continue;
+    d->knownIds.insert(id);
+    d->journal.append(LabelJournal::Added, tweet);
+    fresh.append(tweet);
+    maxId = qMax(maxId, id);
   }
-  if (!d->badTweets.isEmpty()) {
-    qlonglong id = d->badTweets.first().toVariant().toMap()["id"].toLongLong();
-    d->mostRecentId = qMax(id, d->mostRecentId);
+  d->tableModel->insert(fresh);
+  scheduleCards();
+  advanceMostRecentId(maxId);
+  maybeCompactJournal();
+  return fresh.count();
+}
+
+
+// Applies the journal to the queue of unlabeled tweets. Label records
+// are kept until the good and bad tweets are loaded, see applyJournalLabels().
+void MainWindow::replayJournal(void)
+{
+  Q_D(MainWindow);
+  const QList<LabelJournal::Record> &records = d->journal.read();
+  if (records.isEmpty())
+    return;
+  QJsonArray added;
+  foreach (LabelJournal::Record record, records) {
+    if (record.op == LabelJournal::Added) {
+      added.append(record.tweet);
+      continue;
+    }
+    if (!added.isEmpty()) {
+      d->storedTweets.insert(added);
+      added = QJsonArray();
+    }
+    d->storedTweets.remove(TweetStore::tweetId(record.tweet));
+    if (record.op != LabelJournal::Removed)
+      d->journalLabels << record;
   }
-  if (!d->goodTweets.isEmpty()) {
-    qlonglong id = d->goodTweets.first().toVariant().toMap()["id"].toLongLong();
-    d->mostRecentId = qMax(id, d->mostRecentId);
+  if (!added.isEmpty())
+    d->storedTweets.insert(added);
+  qDebug() << "MainWindow::replayJournal()" << records.count() << "records";
+}
+
+
+// Replays the label records of the journal into the good and bad tweet
+// stores once these have been loaded. Tweets already contained in the
+// stores are skipped by TweetStore::insert().
+void MainWindow::applyJournalLabels(void)
+{
+  Q_D(MainWindow);
+  foreach (LabelJournal::Record record, d->journalLabels) {
+    if (record.op == LabelJournal::Liked)
+      d->goodTweets.insert(record.tweet);
+    else
+      d->badTweets.insert(record.tweet);
+  }
+  d->journalLabels.clear();
+}
+
+
+void MainWindow::maybeCompactJournal(void)
+{
+  Q_D(MainWindow);
+  if (!d->storesLoaded)
+    return;
+  const int threshold = d->settings.value("storage/journalCompactionThreshold", DefaultJournalCompactionThreshold).toInt();
+  if (d->journal.count() >= threshold)
+    compactJournal();
+}
+
+
+// Rotates the journal and hands a snapshot of the stores to the
+// background writer. The rotated journal is deleted as soon as the
+// snapshot has been written, see onSnapshotWritten().
+void MainWindow::compactJournal(void)
+{
+  Q_D(MainWindow);
+  const int generation = d->journal.rotate();
+  TweetStore stored = d->storedTweets;
+  const qlonglong currentId = TweetStore::tweetId(d->currentTweet.toObject());
+  if (d->currentTweet.isObject() && !d->goodTweets.contains(currentId) && !d->badTweets.contains(currentId))
+    stored.insert(d->currentTweet.toObject());
+  d->goodTweets.seal();
+  d->badTweets.seal();
+  d->snapshotWriter->schedule(generation, stored, d->goodTweets, d->badTweets);
+}
+
+
+void MainWindow::onSnapshotWritten(int generation, bool ok)
+{
+  Q_D(MainWindow);
+  if (!ok) {
+    qWarning() << "MainWindow::onSnapshotWritten() failed; keeping journal" << d->journal.fileName() << generation;
+    return;
   }
-  qDebug() << d->mostRecentId << lastMostRecentId << (lastMostRecentId <= d->mostRecentId);
+  d->journal.removeRotated(generation);
+  // release the in-memory copies of tweets just written, then the files
+  // of the previous snapshot
+  d->storedTweets.rebase(TweetStore::currentFile(d->tweetFilename));
+  d->goodTweets.rebase(TweetStore::currentFile(d->goodTweetFilename));
+  d->badTweets.rebase(TweetStore::currentFile(d->badTweetFilename));
+  TweetStore::removeStaleFiles(d->tweetFilename);
+  TweetStore::removeStaleFiles(d->goodTweetFilename);
+  TweetStore::removeStaleFiles(d->badTweetFilename);
 }
 
 
-void MainWindow::wordSelected(void)
+// Moves the high-water mark of tweet ids seen so far, which is passed as
+// since_id to the timeline request, and persists it.
+void MainWindow::advanceMostRecentId(qlonglong id)
 {
   Q_D(MainWindow);
-  if (sender() == Q_NULLPTR)
+  if (id <= d->mostRecentId)
     return;
-  QPushButton *btn = reinterpret_cast<QPushButton*>(sender());
+  d->mostRecentId = id;
+  Metrics::add("watermark/moves");
+  Metrics::set("watermark/id", id);
+  scheduleWatermark();
+}
+
+
+// Writing the file includes an fsync, so changes arriving in a burst,
+// e.g. one per reply of a refresh, are written once. A file that lags
+// behind only makes the next refresh fetch some tweets again.
+void MainWindow::scheduleWatermark(void)
+{
+  Q_D(MainWindow);
+  if (!d->watermarkTimer.isActive())
+    d->watermarkTimer.start();
+}
+
+
+// Writes the watermark together with the gaps below it that have not
+// been fetched yet, so that moving the watermark past them does not
+// lose their tweets, not even if the app is killed during a refresh.
+void MainWindow::saveWatermark(void)
+{
+  Q_D(MainWindow);
+  QByteArray data = QByteArray::number(d->mostRecentId) + "\n";
+  if (d->backfill != Q_NULLPTR) {
+    const QList<TimelineBackfill::Range> &gaps = d->backfill->openGaps();
+    foreach (TimelineBackfill::Range gap, gaps)
+      data += QByteArray::number(gap.sinceId) + " " + QByteArray::number(gap.maxId) + "\n";
+    Metrics::set("watermark/openGaps", gaps.count());
+  }
+  QSaveFile file(d->mostRecentIdFilename);
+  if (file.open(QIODevice::WriteOnly)) {
+    file.write(data);
+    file.commit();
+  }
+}
+
+
+void MainWindow::wordSelected(const QString &word)
+{
+  Q_D(MainWindow);
   static const QRegExp reWord("([#\\w-']+)");
-  reWord.exactMatch(btn->text());
+  reWord.exactMatch(word);
   QString w = reWord.cap().trimmed();
   QStringList::const_iterator idx = qBinaryFind(d->relevantWords.constBegin(), d->relevantWords.constEnd(), w, wordComparator);
   if (idx == d->relevantWords.constEnd()) {
@@ -557,20 +1113,31 @@ void MainWindow::wordSelected(void)
 void MainWindow::onCustomMenuRequested(const QPoint &pos)
 {
   Q_D(MainWindow);
-  d->tableContextMenu->popup(ui->tableWidget->viewport()->mapToGlobal(pos));
+  d->tableContextMenu->popup(ui->tableView->viewport()->mapToGlobal(pos));
 }
 
 
 void MainWindow::onDeleteTweet(void)
 {
-  QItemSelectionModel *select = ui->tableWidget->selectionModel();
+  Q_D(MainWindow);
+  QItemSelectionModel *select = ui->tableView->selectionModel();
   if (select->hasSelection()) {
     const QModelIndexList &idxs = select->selectedRows();
-    foreach (QModelIndex idx, idxs) {
-      ui->tableWidget->removeRow(idx.row());
+    QList<int> rows;
+    foreach (QModelIndex idx, idxs)
+      rows << idx.row();
+    // bottom up, so that the rows still to be removed keep their index
+    qSort(rows.begin(), rows.end(), qGreater<int>());
+    foreach (int row, rows) {
+      QJsonObject removed;
+      removed["id_str"] = QString::number(d->tableModel->tweetAt(row).id);
+      if (d->tableModel->removeTweet(row))
+        d->journal.append(LabelJournal::Removed, removed);
     }
+    maybeCompactJournal();
+    scheduleCards();
   }
-  ui->tableWidget->clearSelection();
+  ui->tableView->clearSelection();
 }
 
 
@@ -580,59 +1147,171 @@ void MainWindow::onEvaluateTweet(void)
 }
 
 
-void clearLayout(QLayout *layout) {
-  if (layout != Q_NULLPTR) {
-    QLayoutItem *item;
-    while ((item = layout->takeAt(0)) != Q_NULLPTR) {
-      if (item->layout() != Q_NULLPTR) {
-        clearLayout(item->layout());
-        delete item->layout();
-      }
-      if (item->widget() != Q_NULLPTR) {
-        delete item->widget();
-      }
-      if (item->spacerItem() != Q_NULLPTR) {
-        delete item->spacerItem();
-      }
-    }
-  }
-}
-
-
 void MainWindow::pickNextTweet(void)
 {
   Q_D(MainWindow);
   stopMotion();
-  if (ui->tableWidget->columnCount() > 0 && ui->tableWidget->rowCount() > 0) {
-    clearLayout(ui->tweetFrameLayout->layout());
-    d->currentTweet = d->storedTweets.first();
-    d->storedTweets.pop_front();
-    calculateMostRecentId();
-    static const QRegExp delim("\\s", Qt::CaseSensitive, QRegExp::RegExp2);
-//    static const QRegExp reUrl("^(https?:\\/\\/)?([\\da-z\\.-]+)\\.([a-z\\.]{2,6})([\\/\\w \\.-]*)*\\/?$", Qt::CaseInsensitive, QRegExp::RegExp2);
-    QVariantMap tweet = d->currentTweet.toVariant().toMap();
-    const QStringList &words = tweet["text"].toString().split(delim);
-    QPixmap pix;
-    if (QPixmapCache::find(tweet["user"].toMap()["profile_image_url"].toString(), &pix)) {
-      ui->profileImageLabel->setPixmap(pix);
+  d->swipePending = false;
+  if (d->tableModel->rowCount() > 0) {
+    QElapsedTimer t;
+    t.start();
+    Card card;
+    const qlonglong id = d->tableModel->tweetAt(0).id;
+    for (int i = 0; i < d->cards.count(); ++i) {
+      if (d->cards.at(i).id == id) {
+        card = d->cards.takeAt(i);
+        break;
+      }
+    }
+    if (card.strip != Q_NULLPTR) {
+      Metrics::add("cards/ready");
+      if (card.avatar.isNull())
+        findAvatar(card.tweet.profileImageUrl(), &card.avatar);
+    }
+    else {
+      Metrics::add("cards/builtOnDemand");
+      buildCard(0, &card);
     }
-    ui->profileImageLabel->setToolTip(QString("@%1").arg(tweet["user"].toMap()["name"].toString()));
-    FlowLayout *flowLayout = new FlowLayout(2, 2, 2);
-    foreach (QString word, words) {
-      QPushButton *widget = new QPushButton;
-      widget->setStyleSheet("border: 1px solid #444; background-color: #ffdab9; padding: 1px 2px; font-size: 12pt");
-      widget->setText(word);
-      widget->setCursor(Qt::PointingHandCursor);
-      QObject::connect(widget, SIGNAL(clicked(bool)), SLOT(wordSelected()));
-      flowLayout->addWidget(widget);
+    d->currentTweet = d->tableModel->takeFirst();
+    d->currentCard = card.tweet;
+    if (!d->firstTweetShown) {
+      d->firstTweetShown = true;
+      qDebug() << "MainWindow::pickNextTweet() first tweet after" << d->startupTimer.elapsed() << "ms";
+      ui->statusBar->showMessage(tr("First tweet ready after %1 ms").arg(d->startupTimer.elapsed()), 3000);
     }
-    ui->tableWidget->removeRow(0);
+//    static const QRegExp reUrl("^(https?:\\/\\/)?([\\da-z\\.-]+)\\.([a-z\\.]{2,6})([\\/\\w \\.-]*)*\\/?$", Qt::CaseInsensitive, QRegExp::RegExp2);
+    ui->profileImageLabel->setPixmap(card.avatar);
+    ui->profileImageLabel->setToolTip(QString("@%1").arg(card.tweet.userName()));
+    ui->tweetFrameLayout->removeWidget(d->tokenStrip);
+    d->tokenStrip->hide();
+    d->spareStrips.append(d->tokenStrip);
+    d->tokenStrip = card.strip;
+    ui->tweetFrameLayout->addWidget(d->tokenStrip);
+    d->tokenStrip->show();
+    Metrics::add("card/builds");
+    Metrics::add("card/buildNs", t.nsecsElapsed());
     d->floatInAnimation.setStartValue(d->originalTweetFramePos + QPoint(0, ui->tweetFrame->height()));
     d->floatInAnimation.setEndValue(d->originalTweetFramePos);
     d->floatInAnimation.start();
     d->tweetFrameOpacityEffect->setOpacity(1.0);
-    ui->tweetFrameLayout->addLayout(flowLayout);
+    scheduleCards();
+  }
+  else {
+    d->currentTweet = QJsonValue();
+    d->currentCard = Tweet();
+  }
+}
+
+
+// Builds a card the way it was done before TokenStrip, one styled and
+// connected QPushButton per word laid out in rows, off screen and only
+// to compare card/baselineNs with card/stripNs. Tearing it down is part
+// of the cost, as the old card was torn down for every tweet.
+void MainWindow::measureBaselineCard(const QString &text, int width)
+{
+  QElapsedTimer t;
+  t.start();
+  {
+    QWidget card;
+    int x = 0;
+    int y = 0;
+    int lineHeight = 0;
+    foreach (QString word, text.split(QRegExp("\\s"))) {
+      QPushButton *button = new QPushButton(&card);
+      button->setStyleSheet("border: 1px solid #444; background-color: #ffdab9; padding: 1px 2px; font-size: 12pt");
+      button->setText(word);
+      button->setCursor(Qt::PointingHandCursor);
+      QObject::connect(button, SIGNAL(clicked(bool)), &card, SLOT(update()));
+      const QSize &size = button->sizeHint();
+      if (x > 0 && x + size.width() > width) {
+        x = 0;
+        y += lineHeight + 2;
+        lineHeight = 0;
+      }
+      button->setGeometry(QRect(QPoint(x, y), size));
+      x += size.width() + 2;
+      lineHeight = qMax(lineHeight, size.height());
+    }
+  }
+  Metrics::add("card/baselineBuilds");
+  Metrics::add("card/baselineNs", t.nsecsElapsed());
+}
+
+
+TokenStrip *MainWindow::newTokenStrip(void)
+{
+  Q_D(MainWindow);
+  if (!d->spareStrips.isEmpty())
+    return d->spareStrips.takeLast();
+  TokenStrip *strip = new TokenStrip(ui->tweetFrame);
+  strip->hide();
+  QObject::connect(strip, SIGNAL(tokenClicked(QString)), SLOT(wordSelected(QString)));
+  return strip;
+}
+
+
+// Prepares the card for the tweet in `row` in a hidden token strip laid
+// out for the width of the one on display.
+void MainWindow::buildCard(int row, Card *card)
+{
+  Q_D(MainWindow);
+  card->tweet = d->tableModel->tweetAt(row);
+  card->id = card->tweet.id;
+  QElapsedTimer t;
+  t.start();
+  card->strip = newTokenStrip();
+  card->strip->setText(card->tweet.text);
+  const int width = d->tokenStrip->width();
+  card->strip->resize(width, card->strip->heightForWidth(width));
+  Metrics::add("card/strips");
+  Metrics::add("card/stripNs", t.nsecsElapsed());
+  if (d->measureBaselineCards)
+    measureBaselineCard(card->tweet.text, width);
+  if (!findAvatar(card->tweet.profileImageUrl(), &card->avatar))
+    loadImage(card->tweet.profileImageUrl());
+}
+
+
+// Cards are prepared once the card on display has floated in, so that
+// the preparation does not compete with the animation.
+void MainWindow::scheduleCards(void)
+{
+  Q_D(MainWindow);
+  if (d->cardsScheduled)
+    return;
+  d->cardsScheduled = true;
+  QTimer::singleShot(AnimationDuration, this, SLOT(prepareCards()));
+}
+
+
+// Keeps a card ready for each of the next tweets in the queue, so that a
+// swipe only has to swap in a prepared token strip and avatar. Cards of
+// tweets that are no longer up next are recycled.
+void MainWindow::prepareCards(void)
+{
+  Q_D(MainWindow);
+  d->cardsScheduled = false;
+  QElapsedTimer t;
+  t.start();
+  QHash<qlonglong, Card> previous;
+  foreach (Card card, d->cards)
+    previous.insert(card.id, card);
+  d->cards.clear();
+  const int n = qMin(d->cardLookAhead, d->tableModel->rowCount());
+  for (int row = 0; row < n; ++row) {
+    const qlonglong id = d->tableModel->tweetAt(row).id;
+    Card card = previous.take(id);
+    if (card.strip == Q_NULLPTR) {
+      buildCard(row, &card);
+      Metrics::add("cards/prepared");
+    }
+    d->cards.append(card);
   }
+  foreach (Card card, previous) {
+    card.strip->hide();
+    d->spareStrips.append(card.strip);
+  }
+  Metrics::add("cards/prepareNs", t.nsecsElapsed());
 }
 
 
@@ -640,14 +1319,10 @@ void MainWindow::buildTable(const QJsonArray &mostRecentTweets)
 {
   Q_D(MainWindow);
   if (!mostRecentTweets.isEmpty()) {
-    d->storedTweets = mergeTweets(d->storedTweets, mostRecentTweets);
-    ui->statusBar->showMessage(tr("%1 new entries since id %2").arg(mostRecentTweets.size()).arg(d->mostRecentId), 3000);
-    QFile tweetFile(d->tweetFilename);
-    tweetFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
-    tweetFile.write(QJsonDocument(d->storedTweets).toJson(QJsonDocument::Indented));
-    tweetFile.close();
+    const qlonglong sinceId = d->mostRecentId;
+    const int added = mergeTweets(mostRecentTweets);
+    ui->statusBar->showMessage(tr("%1 new entries since id %2").arg(added).arg(sinceId), 3000);
   }
-  calculateMostRecentId();
 
   if (d->storedTweets.isEmpty() && !d->tableBuildCalled) {
     getUserTimeline();
@@ -655,33 +1330,8 @@ void MainWindow::buildTable(const QJsonArray &mostRecentTweets)
   }
   d->tableBuildCalled = true;
 
-  ui->tableWidget->setRowCount(d->storedTweets.count());
-  int row = 0;
-  foreach(QJsonValue p, d->storedTweets) {
-    const QVariantMap &post = p.toVariant().toMap();
-    const QUrl &imageUrl = QUrl(post["user"].toMap()["profile_image_url"].toString());
-    QTableWidgetItem *imgItem = new QTableWidgetItem;
-    imgItem->setData(Qt::UserRole, imageUrl);
-    QPixmap pix;
-    if (QPixmapCache::find(imageUrl.toString(), &pix)) {
-      imgItem->setData(Qt::DecorationRole, pix);
-    }
-    else {
-      loadImage(imageUrl);
-    }
-    ui->tableWidget->setItem(row, 0, imgItem);
-    QTableWidgetItem *textItem = new QTableWidgetItem(post["text"].toString());
-    textItem->setTextAlignment(Qt::AlignTop | Qt::AlignLeft);
-    ui->tableWidget->setItem(row, 1, textItem);
-    QTableWidgetItem *createdAtItem = new QTableWidgetItem(post["created_at"].toString());
-    createdAtItem->setTextAlignment(Qt::AlignTop | Qt::AlignLeft);
-    ui->tableWidget->setItem(row, 2, createdAtItem);
-    QTableWidgetItem *idItem = new QTableWidgetItem(QString("%1").arg(post["id"].toLongLong()));
-    ui->tableWidget->setItem(row, 3, idItem);
-    idItem->setTextAlignment(Qt::AlignTop | Qt::AlignLeft);
-    ++row;
-  }
-  pickNextTweet();
+  if (d->currentTweet.isNull())
+    pickNextTweet();
 }
 
 
@@ -691,48 +1341,108 @@ void MainWindow::buildTable(void)
 }
 
 
-void MainWindow::gotUserTimeline(QNetworkReply *reply)
+// Called for every batch of tweets as soon as it has been parsed. The
+// tweet on display stays put; new tweets go into the table only.
+void MainWindow::gotUserTimeline(const QJsonArray &tweets)
 {
   Q_D(MainWindow);
-  if (reply->error() != QNetworkReply::NoError) {
-    ui->statusBar->showMessage(tr("Error: %1").arg(reply->errorString()));
-    const QJsonDocument &msg = QJsonDocument::fromJson(reply->readAll());
-    const QList<QVariant> &errors = msg.toVariant().toMap()["errors"].toList();
-    QString errMsg;
-    foreach (QVariant e, errors) {
-      errMsg += QString("%1 (code: %2)\n").arg(e.toMap()["message"].toString()).arg(e.toMap()["code"].toInt());
-    }
-    QMessageBox::warning(this, tr("Error"), errMsg);
+  buildTable(d->projection.apply(tweets));
+}
+
+
+// Called for every failed request of a refresh; only the first failure
+// is kept and reported once the refresh has finished.
+void MainWindow::onTimelineFailed(int httpStatus, const QString &errorString, const QByteArray &body)
+{
+  Q_D(MainWindow);
+  if (d->refreshFailed)
+    return;
+  d->refreshFailed = true;
+  d->refreshFailStatus = httpStatus;
+  d->refreshFailError = errorString;
+  d->refreshFailBody = body;
+}
+
+
+// Only refreshes requested by the user report errors in a message box;
+// the scheduler retries on its own.
+void MainWindow::reportRefreshFailure(void)
+{
+  Q_D(MainWindow);
+  d->scheduler->pollFailed(d->refreshFailStatus);
+  ui->statusBar->showMessage(tr("Error: %1").arg(d->refreshFailError));
+  if (!d->manualRefresh || d->refreshFailStatus == 429)
+    return;
+  const QJsonDocument &msg = QJsonDocument::fromJson(d->refreshFailBody);
+  const QList<QVariant> &errors = msg.toVariant().toMap()["errors"].toList();
+  QString errMsg;
+  foreach (QVariant e, errors) {
+    errMsg += QString("%1 (code: %2)\n").arg(e.toMap()["message"].toString()).arg(e.toMap()["code"].toInt());
+  }
+  QMessageBox::warning(this, tr("Error"), errMsg);
+}
+
+
+// Reports the end-to-end latency of a refresh, i.e. from the first
+// request to the last page being merged into the table. Against the
+// mock server the IngestDriver decides whether another one follows.
+void MainWindow::onBackfillFinished(int tweets, int pages)
+{
+  Q_D(MainWindow);
+  const qint64 ms = qMax(Q_INT64_C(1), d->refreshTimer.elapsed());
+  Metrics::set("ingest/refreshMs", ms);
+  Metrics::set("ingest/tweetsPerSecond", 1000 * tweets / ms);
+  Metrics::add("ingest/refreshes");
+  qDebug() << "MainWindow::onBackfillFinished()" << tweets << "tweets in" << pages << "pages," << ms << "ms," << 1000 * tweets / ms << "tweets/s";
+  if (d->refreshFailed) {
+    reportRefreshFailure();
   }
   else {
-    if (!d->currentTweet.isNull()) {
-      d->storedTweets.push_front(d->currentTweet);
-      d->currentTweet = QJsonValue();
-    }
-    const QJsonArray &mostRecentTweets = QJsonDocument::fromJson(reply->readAll()).array();
-    buildTable(mostRecentTweets);
+    ui->statusBar->showMessage(tr("%1 tweets fetched in %2 pages").arg(tweets).arg(pages), 3000);
+    d->scheduler->pollFinished(tweets, pages);
   }
+  if (d->ingestDriver == Q_NULLPTR)
+    return;
+  d->ingestDriver->refreshFinished(tweets, ms);
+  if (d->ingestDriver->takeRefresh())
+    QTimer::singleShot(0, this, SLOT(getUserTimeline()));
+  else
+    d->ingestDriver->check(d->knownIds, d->backfill->openGaps().count());
 }
 
 
 void MainWindow::getUserTimeline(void)
 {
   Q_D(MainWindow);
-  O1Requestor *requestor = new O1Requestor(&d->tweetNAM, d->oauth, this);
-  QList<O1RequestParameter> reqParams;
-  reqParams << (d->mostRecentId > 0
-                ? O1RequestParameter("since_id", QString::number(d->mostRecentId).toLatin1())
-                : O1RequestParameter("count", "200"));
-  QNetworkRequest request(QUrl("https://api.twitter.com/1.1/statuses/home_timeline.json"));
-  request.setHeader(QNetworkRequest::ContentTypeHeader, O2_MIME_TYPE_XFORM);
-  d->reply = requestor->get(request, reqParams);
+  if (d->backfill->isRunning())
+    return;
+  d->refreshFailed = false;
+  d->refreshTimer.start();
+  d->scheduler->pollStarted();
+  if (d->ingestDriver != Q_NULLPTR)
+    d->ingestDriver->refreshStarted(d->mostRecentId);
+  d->backfill->start(d->mostRecentId);
+}
+
+
+void MainWindow::onScheduledRefresh(void)
+{
+  Q_D(MainWindow);
+  if (d->oauth->linked() || d->ingestDriver != Q_NULLPTR) {
+    d->manualRefresh = false;
+    getUserTimeline();
+  }
+  else {
+    d->scheduler->start();
+  }
 }
 
 
 void MainWindow::onRefresh(void)
 {
   Q_D(MainWindow);
-  if (d->oauth->linked()) {
+  if (d->oauth->linked() || d->ingestDriver != Q_NULLPTR) {
+    d->manualRefresh = true;
     getUserTimeline();
   }
   else {
@@ -741,20 +1451,57 @@ void MainWindow::onRefresh(void)
 }
 
 
-void MainWindow::gotImage(QNetworkReply *reply)
+void MainWindow::gotImage(const QUrl &url, const QByteArray &data)
 {
-  const QUrl &url = reply->request().url();
-  QPixmap pix;
-  pix.loadFromData(reply->readAll());
-  QPixmapCache::insert(url.toString(), pix);
-  ui->tableWidget->resizeColumnToContents(0);
-  for (int row = 0; row < ui->tableWidget->rowCount(); ++row) {
-    QTableWidgetItem *item = ui->tableWidget->item(row, 0);
-    if (url == item->data(Qt::UserRole).toUrl()) {
-      item->setData(Qt::DecorationRole, pix);
-      ui->tableWidget->setRowHeight(row, 48);
-    }
+  Q_D(MainWindow);
+  QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+  QObject::connect(watcher, SIGNAL(finished()), SLOT(onAvatarDecoded()));
+  d->avatarDecodes.insert(watcher, url);
+  Metrics::set("avatars/decodeQueue", ++d->avatarDecodesPending);
+  watcher->setFuture(QtConcurrent::run(&d->decoderPool, decodeAvatar, d->thumbnails, url, data, AvatarSize));
+}
+
+
+void MainWindow::onAvatarDecoded(void)
+{
+  Q_D(MainWindow);
+  QFutureWatcher<QImage> *watcher = static_cast<QFutureWatcher<QImage>*>(sender());
+  const QUrl &url = d->avatarDecodes.take(watcher);
+  const QImage &image = watcher->result();
+  watcher->deleteLater();
+  Metrics::set("avatars/decodeQueue", --d->avatarDecodesPending);
+  if (image.isNull()) {
+    // not an image; a null pixmap in the cache would count as a hit forever
+    Metrics::add("avatars/undecodable");
+    d->avatarFetcher->done(url);
+    d->tableModel->avatarFailed(url);
+    return;
+  }
+  const QPixmap &pix = QPixmap::fromImage(image);
+  d->avatarCache.setVisible(visibleAvatarUrls());
+  d->avatarCache.insert(url, pix);
+  d->avatarFetcher->done(url);
+  d->tableModel->avatarChanged(url);
+  for (int i = 0; i < d->cards.count(); ++i) {
+    if (d->cards.at(i).tweet.profileImageUrl() == url)
+      d->cards[i].avatar = pix;
   }
+  if (d->currentTweet.isObject() && d->currentCard.profileImageUrl() == url)
+    ui->profileImageLabel->setPixmap(pix);
+  if (!d->avatarColumnResizeScheduled) {
+    d->avatarColumnResizeScheduled = true;
+    QTimer::singleShot(0, this, SLOT(resizeAvatarColumn()));
+  }
+}
+
+
+// Images arriving in the same pass through the event loop share a
+// single measurement of the column.
+void MainWindow::resizeAvatarColumn(void)
+{
+  Q_D(MainWindow);
+  d->avatarColumnResizeScheduled = false;
+  ui->tableView->resizeColumnToContents(TweetTableModel::ColumnProfileImage);
 }
 
 
@@ -762,14 +1509,62 @@ void MainWindow::loadImage(const QUrl &url)
 {
   Q_D(MainWindow);
   QPixmap pix;
-  if (!QPixmapCache::find(url.toString(), &pix)) {
-    QNetworkRequest request(url);
-    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
-    d->imageNAM.get(request);
+  if (findAvatar(url, &pix)) {
+    d->tableModel->avatarChanged(url);
+  }
+  else {
+    d->avatarFetcher->fetch(url);
   }
 }
 
 
+// Looks up the avatar in memory, then in the thumbnail cache on disk,
+// which needs neither network access nor decoding.
+bool MainWindow::findAvatar(const QUrl &url, QPixmap *pix)
+{
+  Q_D(MainWindow);
+  if (d->avatarCache.find(url, pix))
+    return true;
+  QImage image;
+  if (!d->thumbnails.load(url, &image))
+    return false;
+  *pix = QPixmap::fromImage(image);
+  d->avatarCache.setVisible(visibleAvatarUrls());
+  d->avatarCache.insert(url, *pix);
+  return true;
+}
+
+
+// The avatars the cache should hold on to: those of the rows in view
+// and of the tweet on display.
+QSet<QUrl> MainWindow::visibleAvatarUrls(void) const
+{
+  Q_D(const MainWindow);
+  QSet<QUrl> urls;
+  if (d->currentTweet.isObject())
+    urls.insert(d->currentCard.profileImageUrl());
+  const int first = ui->tableView->rowAt(0);
+  if (first < 0)
+    return urls;
+  int last = ui->tableView->rowAt(ui->tableView->viewport()->height() - 1);
+  if (last < 0)
+    last = d->tableModel->rowCount() - 1;
+  for (int row = first; row <= last; ++row)
+    urls.insert(UserTable::at(d->storedTweets.userAt(row)).profileImageUrl);
+  return urls;
+}
+
+
+void MainWindow::onDiagnostics(void)
+{
+  const QMap<QString, qint64> &metrics = Metrics::snapshot();
+  QString text;
+  for (QMap<QString, qint64>::const_iterator i = metrics.constBegin(); i != metrics.constEnd(); ++i)
+    text += QString("%1: %2\n").arg(i.key()).arg(i.value());
+  QMessageBox::information(this, tr("Diagnostics"), text.isEmpty() ? tr("No metrics recorded yet.") : text);
+}
+
+
 void MainWindow::onLogout(void)
 {
   Q_D(MainWindow);
@@ -780,7 +1575,8 @@ void MainWindow::onLogout(void)
 void MainWindow::onLogin(void)
 {
   Q_D(MainWindow);
-  d->oauth->link();
+  if (d->ingestDriver == Q_NULLPTR)
+    d->oauth->link();
 }
 
 
@@ -788,11 +1584,17 @@ void MainWindow::like(void)
 {
   Q_D(MainWindow);
   stopMotion();
-  d->goodTweets.push_front(d->currentTweet);
+  if (d->currentTweet.isObject()) {
+    d->goodTweets.insert(d->currentTweet.toObject());
+    d->journal.append(LabelJournal::Liked, d->currentTweet.toObject());
+    advanceMostRecentId(TweetStore::tweetId(d->currentTweet.toObject()));
+    maybeCompactJournal();
+  }
   d->floatOutAnimation.setStartValue(ui->tweetFrame->pos());
   d->floatOutAnimation.setEndValue(d->originalTweetFramePos + QPoint(3 * ui->tweetFrame->width() * 2, 0));
   d->floatOutAnimation.start();
-  QTimer::singleShot(AnimationDuration, this, &MainWindow::pickNextTweet);
+  d->swipePending = true;
+  trackFrames();
 }
 
 
@@ -800,11 +1602,17 @@ void MainWindow::dislike(void)
 {
   Q_D(MainWindow);
   stopMotion();
-  d->badTweets.push_front(d->currentTweet);
+  if (d->currentTweet.isObject()) {
+    d->badTweets.insert(d->currentTweet.toObject());
+    d->journal.append(LabelJournal::Disliked, d->currentTweet.toObject());
+    advanceMostRecentId(TweetStore::tweetId(d->currentTweet.toObject()));
+    maybeCompactJournal();
+  }
   d->floatOutAnimation.setStartValue(ui->tweetFrame->pos());
   d->floatOutAnimation.setEndValue(d->originalTweetFramePos - QPoint(3 * ui->tweetFrame->width() / 2, 0));
   d->floatOutAnimation.start();
-  QTimer::singleShot(AnimationDuration, this, &MainWindow::pickNextTweet);
+  d->swipePending = true;
+  trackFrames();
 }
 
 
@@ -813,8 +1621,8 @@ void MainWindow::saveSettings(void)
   Q_D(MainWindow);
   d->settings.setValue("mainwindow/geometry", saveGeometry());
   d->settings.setValue("mainwindow/state", saveState());
-  for (int c = 0; c < ui->tableWidget->columnCount(); ++c) {
-    d->settings.setValue(QString("table/column/%1/width").arg(c), ui->tableWidget->columnWidth(c));
+  for (int c = 0; c < TweetTableModel::ColumnCount; ++c) {
+    d->settings.setValue(QString("table/column/%1/width").arg(c), ui->tableView->columnWidth(c));
   }
   d->settings.sync();
 }
@@ -825,7 +1633,8 @@ void MainWindow::restoreSettings(void)
   Q_D(MainWindow);
   restoreGeometry(d->settings.value("mainwindow/geometry").toByteArray());
   restoreState(d->settings.value("mainwindow/state").toByteArray());
-  for (int c = 0; c < ui->tableWidget->columnCount(); ++c) {
-    ui->tableWidget->setColumnWidth(c, d->settings.value(QString("table/column/%1/width").arg(c)).toInt());
+  for (int c = 0; c < TweetTableModel::ColumnCount; ++c) {
+    if (d->settings.contains(QString("table/column/%1/width").arg(c)))
+      ui->tableView->setColumnWidth(c, d->settings.value(QString("table/column/%1/width").arg(c)).toInt());
   }
 }
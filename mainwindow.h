@@ -25,7 +25,6 @@
 #include <QUrl>
 #include <QVariantMap>
 #include <QNetworkReply>
-#include <QTimerEvent>
 #include <QEvent>
 #include <QCloseEvent>
 #include <QShowEvent>
@@ -33,12 +32,16 @@
 #include <QPoint>
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QPixmap>
+#include <QSet>
 
 namespace Ui {
 class MainWindow;
 }
 
 class MainWindowPrivate;
+class TokenStrip;
+struct Card;
 
 class MainWindow : public QMainWindow
 {
@@ -51,7 +54,6 @@ public:
 protected:
   void showEvent(QShowEvent*);
   void closeEvent(QCloseEvent*);
-  void timerEvent(QTimerEvent*);
   bool eventFilter(QObject *obj, QEvent *event);
 
 private slots:
@@ -62,17 +64,32 @@ private slots:
   void onCloseBrowser(void);
   void onRefresh(void);
   void getUserTimeline(void);
-  void gotUserTimeline(QNetworkReply*);
-  void gotImage(QNetworkReply*);
+  void gotUserTimeline(const QJsonArray &tweets);
+  void onTimelineFailed(int httpStatus, const QString &errorString, const QByteArray &body);
+  void onScheduledRefresh(void);
+  void onBackfillFinished(int tweets, int pages);
+  void scheduleWatermark(void);
+  void saveWatermark(void);
+  void gotImage(const QUrl &url, const QByteArray &data);
+  void resizeAvatarColumn(void);
+  void onAvatarDecoded(void);
+  void onDiagnostics(void);
+  void loadImage(const QUrl &url);
   void onLogout(void);
   void onLogin(void);
   void like(void);
   void dislike(void);
   void buildTable(void);
-  void wordSelected(void);
+  void wordSelected(const QString &word);
   void onCustomMenuRequested(const QPoint &);
   void onDeleteTweet(void);
   void onEvaluateTweet(void);
+  void onStoredTweetsLoaded(void);
+  void onLabeledTweetsLoaded(void);
+  void onWordListLoaded(void);
+  void onSnapshotWritten(int generation, bool ok);
+  void prepareCards(void);
+  void onFrame(qint64 intervalNs);
 
 private:
   Ui::MainWindow *ui;
@@ -84,18 +101,32 @@ private:
 private: // methods
   void saveSettings(void);
   void restoreSettings(void);
-  QJsonArray mergeTweets(const QJsonArray &a, const QJsonArray &b);
   void startMotion(const QPointF &velocity);
   void stopMotion(void);
+  void trackFrames(void);
   void scrollBy(const QPoint &offset);
   void pickNextTweet(void);
+  TokenStrip *newTokenStrip(void);
+  void buildCard(int row, Card *card);
+  void measureBaselineCard(const QString &text, int width);
+  void scheduleCards(void);
   int likeLimit(void) const;
   int dislikeLimit(void) const;
   bool tweetFloating(void) const;
   void unfloatTweet(void);
   void buildTable(const QJsonArray &mostRecentTweets);
-  void calculateMostRecentId(void);
-  void loadImage(const QUrl &url);
+  void advanceMostRecentId(qlonglong id);
+  void loadStores(void);
+  void onLoadFinished(void);
+  void replayJournal(void);
+  void applyJournalLabels(void);
+  void buildIdIndex(void);
+  int mergeTweets(const QJsonArray &tweets);
+  void maybeCompactJournal(void);
+  void reportRefreshFailure(void);
+  void compactJournal(void);
+  bool findAvatar(const QUrl &url, QPixmap *pix);
+  QSet<QUrl> visibleAvatarUrls(void) const;
 };
 
 #endif // __MAINWINDOW_H_
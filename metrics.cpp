@@ -0,0 +1,54 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "metrics.h"
+
+static QMutex metricsMutex;
+static QMap<QString, qint64> metricsValues;
+
+
+void Metrics::add(const QString &name, qint64 delta)
+{
+  QMutexLocker locker(&metricsMutex);
+  metricsValues[name] += delta;
+}
+
+
+void Metrics::set(const QString &name, qint64 value)
+{
+  QMutexLocker locker(&metricsMutex);
+  metricsValues[name] = value;
+}
+
+
+qint64 Metrics::value(const QString &name)
+{
+  QMutexLocker locker(&metricsMutex);
+  return metricsValues.value(name);
+}
+
+
+QMap<QString, qint64> Metrics::snapshot(void)
+{
+  QMutexLocker locker(&metricsMutex);
+  return metricsValues;
+}
@@ -0,0 +1,38 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __METRICS_H_
+#define __METRICS_H_
+
+#include <QString>
+#include <QMap>
+
+
+// Process-wide named counters and gauges for diagnostics.
+// All functions are thread-safe.
+class Metrics
+{
+public:
+  static void add(const QString &name, qint64 delta = 1);
+  static void set(const QString &name, qint64 value);
+  static qint64 value(const QString &name);
+  static QMap<QString, qint64> snapshot(void);
+};
+
+#endif // __METRICS_H_
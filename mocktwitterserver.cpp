@@ -0,0 +1,274 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QTimer>
+#include <QUrlQuery>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QImage>
+#include <QColor>
+#include <QBuffer>
+#include <QLocale>
+#include <QStringList>
+#include <QtGlobal>
+
+#include "mocktwitterserver.h"
+
+// Spacing of consecutive synthetic ids, roughly that of snowflake ids
+// for tweets a few milliseconds apart.
+static const qlonglong IdStep = Q_INT64_C(1) << 24;
+static const qlonglong FirstId = Q_INT64_C(600000000000000000);
+static const int MaxPageSize = 200;
+
+static const char *Words[] = {
+  "Qt", "C++", "#heise", "ct", "Twitter", "machine", "learning", "tweet", "speed", "cache",
+  "memory", "thread", "index", "store", "journal", "latency", "#qt5", "render", "pixel", "model"
+};
+static const int WordCount = int(sizeof(Words) / sizeof(Words[0]));
+
+
+MockTwitterServer::MockTwitterServer(const Options &options, QObject *parent)
+  : QObject(parent)
+  , mOptions(options)
+  , mRequests(0)
+  , mBurstTweets(0)
+  , mBurstsLeft(options.bursts)
+  , mRemaining(options.rateLimit)
+  , mWindowReset(0)
+{
+  QObject::connect(&mServer, SIGNAL(newConnection()), SLOT(onNewConnection()));
+}
+
+
+bool MockTwitterServer::listen(void)
+{
+  mClock.start();
+  mEpoch = QDateTime::currentDateTimeUtc().addMSecs(-qint64(mOptions.history) * 1000 / qMax(1, mOptions.tweetsPerSecond));
+  mWindowReset = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() / 1000 + mOptions.rateLimitWindow;
+  const bool ok = mServer.listen(QHostAddress::LocalHost, mOptions.port);
+  qDebug() << "MockTwitterServer listening on" << baseUrl() << ok;
+  return ok;
+}
+
+
+QUrl MockTwitterServer::baseUrl(void) const
+{
+  return QUrl(QString("http://127.0.0.1:%1/1.1/").arg(mServer.serverPort()));
+}
+
+
+int MockTwitterServer::requestCount(void) const
+{
+  return mRequests;
+}
+
+
+// Returns the ids of all tweets published so far that are newer than
+// `sinceId` and not deleted, so that a client can check it has not
+// missed any.
+QVector<qlonglong> MockTwitterServer::idsNewerThan(qlonglong sinceId) const
+{
+  QVector<qlonglong> ids;
+  for (int i = tweetCount() - 1; i >= 0 && idOf(i) > sinceId; --i) {
+    if (!isDeleted(i))
+      ids.append(idOf(i));
+  }
+  return ids;
+}
+
+
+void MockTwitterServer::onNewConnection(void)
+{
+  while (mServer.hasPendingConnections()) {
+    QTcpSocket *socket = mServer.nextPendingConnection();
+    QObject::connect(socket, SIGNAL(readyRead()), SLOT(onReadyRead()));
+    QObject::connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+  }
+}
+
+
+void MockTwitterServer::onReadyRead(void)
+{
+  QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+  if (socket == Q_NULLPTR)
+    return;
+  if (!mBuffers.contains(socket))
+    QObject::connect(socket, &QObject::destroyed, this, [this, socket]() { mBuffers.remove(socket); });
+  QByteArray &buffer = mBuffers[socket];
+  buffer += socket->readAll();
+  const int end = buffer.indexOf("\r\n\r\n");
+  if (end < 0)
+    return;
+  const QList<QByteArray> &requestLine = buffer.left(buffer.indexOf("\r\n")).split(' ');
+  mBuffers.remove(socket);
+  if (requestLine.count() < 2) {
+    send(socket, 400, "text/plain", "Bad Request");
+    return;
+  }
+  const QByteArray method = requestLine.at(0);
+  const QUrl url(QString::fromLatin1(requestLine.at(1)));
+  ++mRequests;
+  QTimer::singleShot(mOptions.latencyMs, socket, [this, socket, method, url]() {
+    respond(socket, method, url);
+  });
+}
+
+
+void MockTwitterServer::respond(QTcpSocket *socket, const QByteArray &method, const QUrl &url)
+{
+  if (method != "GET") {
+    send(socket, 405, "text/plain", "Method Not Allowed");
+    return;
+  }
+  const QString &path = url.path();
+  if (path.startsWith("/avatars/")) {
+    send(socket, 200, "image/png", avatar(path.mid(9).section('.', 0, 0).toInt()));
+    return;
+  }
+  if (path != "/1.1/statuses/home_timeline.json") {
+    send(socket, 404, "application/json", "{\"errors\":[{\"message\":\"Sorry, that page does not exist\",\"code\":34}]}");
+    return;
+  }
+  const qint64 now = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() / 1000;
+  if (now >= mWindowReset) {
+    mWindowReset = now + mOptions.rateLimitWindow;
+    mRemaining = mOptions.rateLimit;
+  }
+  if (mOptions.rateLimit > 0) {
+    if (mRemaining <= 0) {
+      send(socket, 429, "application/json", "{\"errors\":[{\"message\":\"Rate limit exceeded\",\"code\":88}]}", rateLimitHeaders());
+      return;
+    }
+    --mRemaining;
+  }
+  if (mOptions.errorRate > 0 && qrand() < mOptions.errorRate * RAND_MAX) {
+    send(socket, 503, "application/json", "{\"errors\":[{\"message\":\"Over capacity\",\"code\":130}]}", rateLimitHeaders());
+    return;
+  }
+  // the first request of a refresh is the only one without max_id
+  const QUrlQuery query(url);
+  if (mBurstsLeft > 0 && query.hasQueryItem("since_id") && !query.hasQueryItem("max_id")) {
+    --mBurstsLeft;
+    mBurstTweets += mOptions.burst;
+  }
+  send(socket, 200, "application/json;charset=utf-8", homeTimeline(url), rateLimitHeaders());
+}
+
+
+void MockTwitterServer::send(QTcpSocket *socket, int status, const QByteArray &contentType, const QByteArray &body, const QByteArray &extraHeaders)
+{
+  QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " Mock\r\n";
+  response += "Content-Type: " + contentType + "\r\n";
+  response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  response += extraHeaders;
+  response += "Connection: close\r\n\r\n";
+  response += body;
+  socket->write(response);
+  socket->disconnectFromHost();
+}
+
+
+QByteArray MockTwitterServer::rateLimitHeaders(void) const
+{
+  if (mOptions.rateLimit <= 0)
+    return QByteArray();
+  return "x-rate-limit-limit: " + QByteArray::number(mOptions.rateLimit) + "\r\n"
+      + "x-rate-limit-remaining: " + QByteArray::number(qMax(0, mRemaining)) + "\r\n"
+      + "x-rate-limit-reset: " + QByteArray::number(mWindowReset) + "\r\n";
+}
+
+
+// Returns the newest `count` tweets with since_id < id <= max_id,
+// newest first, as the real endpoint does, less the deleted ones among
+// them.
+QByteArray MockTwitterServer::homeTimeline(const QUrl &url) const
+{
+  const QUrlQuery query(url);
+  const int count = qBound(1, query.queryItemValue("count").toInt() > 0 ? query.queryItemValue("count").toInt() : 20, MaxPageSize);
+  const qlonglong sinceId = query.queryItemValue("since_id").toLongLong();
+  const qlonglong maxId = query.queryItemValue("max_id").toLongLong();
+  int i = tweetCount() - 1;
+  if (maxId > 0)
+    i = qMin(i, int((maxId - FirstId) / IdStep));
+  QJsonArray tweets;
+  for (int n = 0; i >= 0 && n < count && idOf(i) > sinceId; --i, ++n) {
+    if (!isDeleted(i))
+      tweets.append(tweet(i));
+  }
+  return QJsonDocument(tweets).toJson(QJsonDocument::Compact);
+}
+
+
+QByteArray MockTwitterServer::avatar(int user)
+{
+  if (!mAvatars.contains(user)) {
+    QImage image(mOptions.avatarSize, mOptions.avatarSize, QImage::Format_RGB32);
+    image.fill(QColor::fromHsv((user * 37) % 360, 160, 220));
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    mAvatars.insert(user, png);
+  }
+  return mAvatars.value(user);
+}
+
+
+QJsonObject MockTwitterServer::tweet(int i) const
+{
+  const qlonglong id = idOf(i);
+  const int user = i % qMax(1, mOptions.users);
+  QStringList words;
+  for (int w = 0; w < 8 + i % 10; ++w)
+    words << QString::fromLatin1(Words[(i * 7 + w * 13) % WordCount]);
+  QJsonObject u;
+  u["id_str"] = QString::number(1000 + user);
+  u["name"] = QString("Mock User %1").arg(user);
+  u["screen_name"] = QString("mock%1").arg(user);
+  u["profile_image_url"] = QString("http://127.0.0.1:%1/avatars/%2.png").arg(mServer.serverPort()).arg(user);
+  QJsonObject t;
+  t["id"] = double(id);
+  t["id_str"] = QString::number(id);
+  t["created_at"] = QLocale::c().toString(mEpoch.addMSecs(qint64(i) * 1000 / qMax(1, mOptions.tweetsPerSecond)), "ddd MMM dd HH:mm:ss +0000 yyyy");
+  t["text"] = words.join(' ');
+  t["lang"] = QString("en");
+  t["user"] = u;
+  return t;
+}
+
+
+// The initial history plus the tweets that have "arrived" since listen().
+int MockTwitterServer::tweetCount(void) const
+{
+  return mOptions.history + mBurstTweets + int(mClock.elapsed() * mOptions.tweetsPerSecond / 1000);
+}
+
+
+qlonglong MockTwitterServer::idOf(int i) const
+{
+  return FirstId + qlonglong(i) * IdStep;
+}
+
+
+// Picks the same tweets on every call, spread over the whole timeline.
+bool MockTwitterServer::isDeleted(int i) const
+{
+  return mOptions.deletedRate > 0 && (quint32(i) * 2654435761u) % 1000 < quint32(mOptions.deletedRate * 1000);
+}
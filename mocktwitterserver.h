@@ -0,0 +1,111 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __MOCKTWITTERSERVER_H_
+#define __MOCKTWITTERSERVER_H_
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+
+// Local stand-in for the parts of the Twitter REST API the app uses:
+// statuses/home_timeline.json and profile images. Tweets are synthesized
+// at a configurable rate on top of an initial history; responses can be
+// delayed, fail at random and carry rate-limit headers. Like the real
+// API, pages can come back short because deleted tweets are removed
+// only after the count has been applied. OAuth headers
+// are accepted and ignored.
+class MockTwitterServer : public QObject
+{
+  Q_OBJECT
+
+public:
+  struct Options {
+    Options(void)
+      : port(0)
+      , history(1000)
+      , tweetsPerSecond(5)
+      , users(100)
+      , latencyMs(50)
+      , errorRate(0.0)
+      , rateLimit(15)
+      , rateLimitWindow(900)
+      , avatarSize(48)
+      , burst(0)
+      , bursts(0)
+      , deletedRate(0.0)
+    { /* ... */ }
+    quint16 port; // 0 picks a free port
+    int history;
+    int tweetsPerSecond;
+    int users;
+    int latencyMs;
+    qreal errorRate;
+    int rateLimit; // requests per window, 0 disables the limit
+    int rateLimitWindow; // seconds
+    int avatarSize;
+    int burst; // tweets arriving at once when a refresh starts
+    int bursts; // number of refreshes that trigger a burst
+    qreal deletedRate; // share of tweets dropped from pages after the count is applied
+  };
+
+  explicit MockTwitterServer(const Options &options = Options(), QObject *parent = Q_NULLPTR);
+
+  bool listen(void);
+  QUrl baseUrl(void) const;
+  int requestCount(void) const;
+  QVector<qlonglong> idsNewerThan(qlonglong sinceId) const;
+
+private slots:
+  void onNewConnection(void);
+  void onReadyRead(void);
+
+private:
+  void respond(QTcpSocket *socket, const QByteArray &method, const QUrl &url);
+  void send(QTcpSocket *socket, int status, const QByteArray &contentType, const QByteArray &body, const QByteArray &extraHeaders = QByteArray());
+  QByteArray homeTimeline(const QUrl &url) const;
+  QByteArray avatar(int user);
+  QJsonObject tweet(int i) const;
+  int tweetCount(void) const;
+  qlonglong idOf(int i) const;
+  bool isDeleted(int i) const;
+  QByteArray rateLimitHeaders(void) const;
+
+  Options mOptions;
+  QTcpServer mServer;
+  QElapsedTimer mClock;
+  QDateTime mEpoch;
+  QHash<QTcpSocket*, QByteArray> mBuffers;
+  QHash<int, QByteArray> mAvatars;
+  int mRequests;
+  int mBurstTweets;
+  int mBurstsLeft;
+  int mRemaining;
+  qint64 mWindowReset;
+};
+
+#endif // __MOCKTWITTERSERVER_H_
@@ -0,0 +1,166 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <qmath.h>
+
+#include "refreshscheduler.h"
+#include "metrics.h"
+
+// weight of the latest observation in the smoothed averages
+static const qreal Smoothing = 0.3;
+static const int MaxBackoffExponent = 6;
+
+
+RefreshScheduler::RefreshScheduler(QObject *parent)
+  : QObject(parent)
+  , mMinInterval(DefaultMinInterval)
+  , mMaxInterval(DefaultMaxInterval)
+  , mDefaultInterval(DefaultInterval)
+  , mTargetTweets(DefaultTargetTweets)
+  , mArrivalRate(0)
+  , mRateSamples(0)
+  , mRequestsPerPoll(1)
+  , mRemaining(-1)
+  , mLimit(-1)
+  , mReset(0)
+  , mFailures(0)
+  , mActive(false)
+{
+  mTimer.setSingleShot(true);
+  QObject::connect(&mTimer, SIGNAL(timeout()), SIGNAL(pollDue()));
+}
+
+
+void RefreshScheduler::setIntervals(int minMs, int maxMs)
+{
+  mMinInterval = qMax(1000, minMs);
+  mMaxInterval = qMax(mMinInterval, maxMs);
+}
+
+
+// The interval used until two polls have given a first arrival rate.
+void RefreshScheduler::setDefaultInterval(int ms)
+{
+  mDefaultInterval = qMax(1000, ms);
+}
+
+
+void RefreshScheduler::setTargetTweets(int n)
+{
+  mTargetTweets = qMax(1, n);
+}
+
+
+void RefreshScheduler::start(void)
+{
+  mActive = true;
+  if (!mTimer.isActive())
+    schedule(mMinInterval);
+}
+
+
+void RefreshScheduler::stop(void)
+{
+  mActive = false;
+  mTimer.stop();
+}
+
+
+// Polls may also be started by hand; they count against the budget
+// all the same.
+void RefreshScheduler::pollStarted(void)
+{
+  mTimer.stop();
+}
+
+
+void RefreshScheduler::pollFinished(int tweets, int requests)
+{
+  const QDateTime &now = QDateTime::currentDateTimeUtc();
+  if (mLastPoll.isValid()) {
+    const qreal seconds = qMax(qreal(1), mLastPoll.msecsTo(now) / qreal(1000));
+    const qreal rate = tweets / seconds;
+    mArrivalRate = mRateSamples == 0 ? rate : (1 - Smoothing) * mArrivalRate + Smoothing * rate;
+    ++mRateSamples;
+  }
+  mLastPoll = now;
+  mRequestsPerPoll = (1 - Smoothing) * mRequestsPerPoll + Smoothing * qMax(1, requests);
+  mFailures = 0;
+  Metrics::set("scheduler/arrivalRateMilli", qint64(1000 * mArrivalRate));
+  Metrics::set("scheduler/failures", 0);
+  int ms = mDefaultInterval;
+  if (mRateSamples > 0) {
+    ms = mMaxInterval;
+    if (mArrivalRate > 0)
+      ms = int(qMin(qreal(mMaxInterval), 1000 * mTargetTweets / mArrivalRate));
+  }
+  schedule(qMax(ms, budgetInterval()));
+}
+
+
+void RefreshScheduler::pollFailed(int httpStatus)
+{
+  ++mFailures;
+  Metrics::set("scheduler/failures", mFailures);
+  const qint64 now = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() / 1000;
+  if (httpStatus == 429 && mReset > now) {
+    schedule(int(qMin(qint64(mMaxInterval), 1000 * (mReset - now + 1))));
+    return;
+  }
+  const int backoff = int(qMin(qreal(mMaxInterval), mMinInterval * qPow(2, qMin(mFailures - 1, MaxBackoffExponent))));
+  schedule(qMax(backoff, budgetInterval()));
+}
+
+
+void RefreshScheduler::rateLimitUpdated(int remaining, int limit, qint64 reset)
+{
+  mRemaining = remaining;
+  mLimit = limit;
+  mReset = reset;
+  Metrics::set("scheduler/budgetRemaining", remaining);
+  Metrics::set("scheduler/budgetLimit", limit);
+  Metrics::set("scheduler/budgetReset", reset);
+}
+
+
+// The shortest interval that spreads the remaining requests evenly
+// until the rate limit window resets.
+int RefreshScheduler::budgetInterval(void) const
+{
+  if (mRemaining < 0)
+    return 0;
+  const qint64 now = QDateTime::currentDateTimeUtc().toMSecsSinceEpoch() / 1000;
+  const qint64 window = qMax(Q_INT64_C(0), mReset - now) * 1000;
+  const qreal pollsLeft = mRemaining / qMax(qreal(1), mRequestsPerPoll);
+  if (pollsLeft < 1)
+    return int(qMin(qint64(mMaxInterval), window + 1000));
+  return int(qMin(qreal(mMaxInterval), window / pollsLeft));
+}
+
+
+void RefreshScheduler::schedule(int ms)
+{
+  ms = qBound(mMinInterval, ms, mMaxInterval);
+  Metrics::set("scheduler/nextPollMs", ms);
+  if (!mActive)
+    return;
+  mTimer.start(ms);
+  qDebug() << "RefreshScheduler: next poll in" << ms << "ms, budget" << mRemaining << "of" << mLimit;
+}
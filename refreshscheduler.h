@@ -0,0 +1,83 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __REFRESHSCHEDULER_H_
+#define __REFRESHSCHEDULER_H_
+
+#include <QObject>
+#include <QTimer>
+#include <QDateTime>
+
+
+// Decides when to poll the home timeline next. The interval follows the
+// observed tweet arrival rate, so that a poll finds about half a page of
+// new tweets, but is stretched so that the remaining rate-limit budget
+// lasts until the limit resets. Until two polls have given a first rate,
+// a default interval is used. Failed polls back off exponentially;
+// an exhausted budget (HTTP 429) waits for the reset.
+class RefreshScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum {
+    DefaultMinInterval = 60 * 1000,
+    DefaultMaxInterval = 15 * 60 * 1000,
+    DefaultInterval = 3 * 60 * 1000,
+    DefaultTargetTweets = 100
+  };
+
+  explicit RefreshScheduler(QObject *parent = Q_NULLPTR);
+
+  void setIntervals(int minMs, int maxMs);
+  void setDefaultInterval(int ms);
+  void setTargetTweets(int n);
+
+public slots:
+  void start(void);
+  void stop(void);
+  void pollStarted(void);
+  void pollFinished(int tweets, int requests);
+  void pollFailed(int httpStatus);
+  void rateLimitUpdated(int remaining, int limit, qint64 reset);
+
+signals:
+  void pollDue(void);
+
+private:
+  void schedule(int ms);
+  int budgetInterval(void) const;
+
+  QTimer mTimer;
+  QDateTime mLastPoll;
+  int mMinInterval;
+  int mMaxInterval;
+  int mDefaultInterval;
+  int mTargetTweets;
+  qreal mArrivalRate; // tweets per second, smoothed
+  int mRateSamples;
+  qreal mRequestsPerPoll; // smoothed
+  int mRemaining;
+  int mLimit;
+  qint64 mReset; // seconds since epoch
+  int mFailures;
+  bool mActive;
+};
+
+#endif // __REFRESHSCHEDULER_H_
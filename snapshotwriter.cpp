@@ -0,0 +1,135 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include "snapshotwriter.h"
+
+static const int DefaultDelay = 2000;
+
+
+SnapshotWriter::SnapshotWriter(const QString &tweetFilename, const QString &goodTweetFilename, const QString &badTweetFilename)
+  : mTimer(this)
+  , mDelay(DefaultDelay)
+  , mLastWrittenGeneration(0)
+  , mTweetFilename(tweetFilename)
+  , mGoodTweetFilename(goodTweetFilename)
+  , mBadTweetFilename(badTweetFilename)
+  , mPending(false)
+  , mTimedOut(false)
+  , mGeneration(0)
+{
+  mTimer.setSingleShot(true);
+  QObject::connect(&mTimer, SIGNAL(timeout()), SLOT(write()));
+  moveToThread(&mThread);
+  mThread.start(QThread::LowPriority);
+}
+
+
+SnapshotWriter::~SnapshotWriter()
+{
+  mThread.quit();
+  mThread.wait();
+}
+
+
+void SnapshotWriter::setDelay(int ms)
+{
+  mDelay.store(ms);
+}
+
+
+// Takes a copy of the stores (cheap, as their data is implicitly shared)
+// to be written once the delay has expired. Can be called from any thread.
+void SnapshotWriter::schedule(int generation, const TweetStore &storedTweets, const LabelArchive &goodTweets, const LabelArchive &badTweets)
+{
+  QMutexLocker locker(&mMutex);
+  mGeneration = generation;
+  mStoredTweets = storedTweets;
+  mGoodTweets = goodTweets;
+  mBadTweets = badTweets;
+  mPending = true;
+  locker.unlock();
+  QMetaObject::invokeMethod(this, "arm", Qt::QueuedConnection);
+}
+
+
+// Writes a pending snapshot right away and stops the writer thread.
+// Returns false if that didn't finish within `timeoutMs`. Once it has
+// timed out, further calls return at once.
+bool SnapshotWriter::shutdown(int timeoutMs)
+{
+  if (mThread.isFinished())
+    return true;
+  if (mTimedOut)
+    return false;
+  QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+  mTimedOut = !mThread.wait(ulong(timeoutMs));
+  return !mTimedOut;
+}
+
+
+int SnapshotWriter::lastWrittenGeneration(void) const
+{
+  return mLastWrittenGeneration.load();
+}
+
+
+void SnapshotWriter::arm(void)
+{
+  if (!mTimer.isActive())
+    mTimer.start(mDelay.load());
+}
+
+
+void SnapshotWriter::finish(void)
+{
+  write();
+  mThread.quit();
+}
+
+
+void SnapshotWriter::write(void)
+{
+  mTimer.stop();
+  QMutexLocker locker(&mMutex);
+  if (!mPending)
+    return;
+  const int generation = mGeneration;
+  const TweetStore storedTweets = mStoredTweets;
+  const LabelArchive goodTweets = mGoodTweets;
+  const LabelArchive badTweets = mBadTweets;
+  mStoredTweets.clear();
+  mGoodTweets = LabelArchive();
+  mBadTweets = LabelArchive();
+  mPending = false;
+  locker.unlock();
+
+  QElapsedTimer t;
+  t.start();
+  bool ok = storedTweets.save(TweetStore::nextFile(mTweetFilename));
+  ok = ok && goodTweets.save(TweetStore::nextFile(mGoodTweetFilename));
+  ok = ok && badTweets.save(TweetStore::nextFile(mBadTweetFilename));
+  qDebug() << "SnapshotWriter::write() generation" << generation << (ok ? "written in" : "FAILED after") << t.elapsed() << "ms";
+  if (ok)
+    mLastWrittenGeneration.store(generation);
+  emit written(generation, ok);
+}
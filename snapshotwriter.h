@@ -0,0 +1,78 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __SNAPSHOTWRITER_H_
+#define __SNAPSHOTWRITER_H_
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "tweetstore.h"
+#include "labelarchive.h"
+
+
+// Writes snapshots of the tweet stores on a thread of its own. Snapshots
+// scheduled while a write is pending replace each other, so a burst of
+// changes results in a single write after the configured delay. Each
+// snapshot goes to a new generation of the store files, see
+// TweetStore::currentFile(), as the current ones are still mapped.
+// Delete the writer only after shutdown() has succeeded; a writer whose
+// shutdown timed out is still busy and has to be abandoned instead.
+class SnapshotWriter : public QObject
+{
+  Q_OBJECT
+
+public:
+  SnapshotWriter(const QString &tweetFilename, const QString &goodTweetFilename, const QString &badTweetFilename);
+  ~SnapshotWriter();
+
+  void setDelay(int ms);
+  void schedule(int generation, const TweetStore &storedTweets, const LabelArchive &goodTweets, const LabelArchive &badTweets);
+  bool shutdown(int timeoutMs);
+  int lastWrittenGeneration(void) const;
+
+signals:
+  void written(int generation, bool ok);
+
+private slots:
+  void arm(void);
+  void finish(void);
+  void write(void);
+
+private:
+  QThread mThread;
+  QTimer mTimer;
+  QMutex mMutex;
+  QAtomicInt mDelay;
+  QAtomicInt mLastWrittenGeneration;
+  const QString mTweetFilename;
+  const QString mGoodTweetFilename;
+  const QString mBadTweetFilename;
+  bool mPending;
+  bool mTimedOut;
+  int mGeneration;
+  TweetStore mStoredTweets;
+  LabelArchive mGoodTweets;
+  LabelArchive mBadTweets;
+};
+
+#endif // __SNAPSHOTWRITER_H_
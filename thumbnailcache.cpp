@@ -0,0 +1,150 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <cstring>
+
+#include "thumbnailcache.h"
+#include "metrics.h"
+
+// File layout (little endian): magic "TWTH", width, height, bytes per
+// line (32 bit each), then height * bytes per line pixel bytes in
+// QImage::Format_ARGB32_Premultiplied.
+static const char Magic[4] = { 'T', 'W', 'T', 'H' };
+static const int HeaderSize = 16;
+static const int MaxDimension = 1024;
+
+
+ThumbnailCache::ThumbnailCache(void)
+{
+  /* ... */
+}
+
+
+ThumbnailCache::ThumbnailCache(const QString &directory)
+  : mDirectory(directory)
+{
+  QDir().mkpath(directory);
+}
+
+
+// A hit marks the file as recently used, so that evict() drops the
+// thumbnails that haven't been shown for the longest time. A file that
+// cannot be read back counts as a miss and is removed.
+bool ThumbnailCache::load(const QUrl &url, QImage *image) const
+{
+  if (mDirectory.isEmpty())
+    return false;
+  const QString &filename = fileName(url);
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    Metrics::add("thumbnails/misses");
+    return false;
+  }
+  const QByteArray &data = file.readAll();
+  file.close();
+  const uchar *h = reinterpret_cast<const uchar*>(data.constData());
+  bool valid = data.size() >= HeaderSize && std::memcmp(h, Magic, sizeof(Magic)) == 0;
+  const int width = valid ? int(qFromLittleEndian<quint32>(h + 4)) : 0;
+  const int height = valid ? int(qFromLittleEndian<quint32>(h + 8)) : 0;
+  const int bytesPerLine = valid ? int(qFromLittleEndian<quint32>(h + 12)) : 0;
+  valid = valid && width > 0 && height > 0 && width <= MaxDimension && height <= MaxDimension
+      && bytesPerLine >= 4 * width && data.size() == HeaderSize + height * bytesPerLine;
+  if (!valid) {
+    QFile::remove(filename);
+    Metrics::add("thumbnails/misses");
+    Metrics::add("thumbnails/corrupt");
+    return false;
+  }
+  *image = QImage(h + HeaderSize, width, height, bytesPerLine, QImage::Format_ARGB32_Premultiplied).copy();
+  Metrics::add("thumbnails/hits");
+  touch(filename);
+  return true;
+}
+
+
+bool ThumbnailCache::store(const QUrl &url, const QImage &image) const
+{
+  if (mDirectory.isEmpty() || image.isNull())
+    return false;
+  const QImage &argb = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+  uchar header[HeaderSize];
+  std::memcpy(header, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(quint32(argb.width()), header + 4);
+  qToLittleEndian<quint32>(quint32(argb.height()), header + 8);
+  qToLittleEndian<quint32>(quint32(argb.bytesPerLine()), header + 12);
+  QSaveFile file(fileName(url));
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(reinterpret_cast<const char*>(header), HeaderSize);
+  file.write(reinterpret_cast<const char*>(argb.constBits()), argb.byteCount());
+  return file.commit();
+}
+
+
+// Removes thumbnails not used for `maxAgeDays`, then the least recently
+// used ones until the remaining files take up no more than `maxBytes`.
+void ThumbnailCache::evict(qint64 maxBytes, int maxAgeDays) const
+{
+  if (mDirectory.isEmpty())
+    return;
+  const QDateTime &oldest = QDateTime::currentDateTime().addDays(-maxAgeDays);
+  const QFileInfoList &files = QDir(mDirectory).entryInfoList(QStringList() << "*.argb", QDir::Files, QDir::Time);
+  qint64 total = 0;
+  int evicted = 0;
+  foreach (QFileInfo fi, files) {
+    if (fi.lastModified() < oldest || total + fi.size() > maxBytes) {
+      if (QFile::remove(fi.filePath()))
+        ++evicted;
+    }
+    else {
+      total += fi.size();
+    }
+  }
+  Metrics::add("thumbnails/evicted", evicted);
+  Metrics::set("thumbnails/bytes", total);
+  qDebug() << "ThumbnailCache::evict()" << evicted << "evicted," << total << "bytes kept";
+}
+
+
+// Sets the modification time of `filename` to now, at most once a day
+// per file to keep the writes down; eviction works in days anyway.
+void ThumbnailCache::touch(const QString &filename) const
+{
+  const QDateTime &now = QDateTime::currentDateTimeUtc();
+  const QFileInfo fi(filename);
+  if (!fi.exists() || fi.lastModified().toUTC().addDays(1) > now)
+    return;
+  QFile file(filename);
+  if (file.open(QIODevice::ReadWrite))
+    file.setFileTime(now, QFileDevice::FileModificationTime);
+}
+
+
+QString ThumbnailCache::fileName(const QUrl &url) const
+{
+  return mDirectory + "/" + QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex() + ".argb";
+}
@@ -0,0 +1,54 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __THUMBNAILCACHE_H_
+#define __THUMBNAILCACHE_H_
+
+#include <QString>
+#include <QUrl>
+#include <QImage>
+
+
+// On-disk cache of avatars that have already been decoded and scaled,
+// one file per URL holding the raw premultiplied ARGB pixels, so that
+// loading a thumbnail is a plain read without any image decoding.
+// All methods may be called from any thread.
+class ThumbnailCache
+{
+public:
+  enum {
+    DefaultMaxBytes = 20 * 1024 * 1024,
+    DefaultMaxAgeDays = 30
+  };
+
+  ThumbnailCache(void);
+  explicit ThumbnailCache(const QString &directory);
+
+  bool load(const QUrl &url, QImage *image) const;
+  bool store(const QUrl &url, const QImage &image) const;
+  void evict(qint64 maxBytes, int maxAgeDays) const;
+
+private:
+  QString fileName(const QUrl &url) const;
+  void touch(const QString &filename) const;
+
+  QString mDirectory;
+};
+
+#endif // __THUMBNAILCACHE_H_
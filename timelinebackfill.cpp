@@ -0,0 +1,294 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QUrlQuery>
+#include <QJsonObject>
+
+#include "timelinebackfill.h"
+#include "tweetstore.h"
+#include "metrics.h"
+
+#include "o1twitter.h"
+#include "o1requestor.h"
+#include "o2globals.h"
+
+
+TimelineBackfill::TimelineBackfill(QNetworkAccessManager *nam, O1Twitter *oauth, QObject *parent)
+  : QObject(parent)
+  , mRequestor(new O1Requestor(nam, oauth, this))
+  , mBaseUrl("https://api.twitter.com/1.1/")
+  , mPageSize(DefaultPageSize)
+  , mMaxInFlight(DefaultMaxInFlight)
+  , mMaxPages(DefaultMaxPages)
+  , mPagesRequested(0)
+  , mTweetsReceived(0)
+  , mRunning(false)
+  , mStopping(false)
+{
+  /* ... */
+}
+
+
+// `url` is the API root, e.g. http://localhost:8080/1.1/ for a local
+// stand-in of the Twitter API.
+void TimelineBackfill::setBaseUrl(const QUrl &url)
+{
+  mBaseUrl = url;
+}
+
+
+void TimelineBackfill::setMaxInFlight(int n)
+{
+  mMaxInFlight = qMax(1, n);
+}
+
+
+void TimelineBackfill::setMaxPages(int n)
+{
+  mMaxPages = qMax(1, n);
+}
+
+
+bool TimelineBackfill::isRunning(void) const
+{
+  return mRunning;
+}
+
+
+// Gaps left open by an earlier run, e.g. as read back from disk. They
+// are resumed by the next start().
+void TimelineBackfill::setOpenGaps(const QList<Range> &gaps)
+{
+  if (mRunning)
+    return;
+  mGaps.clear();
+  foreach (Range gap, gaps) {
+    if (gap.sinceId > 0 && (gap.maxId == 0 || gap.maxId > gap.sinceId))
+      mGaps.append(gap);
+  }
+}
+
+
+// Returns the id ranges not fetched yet: open gaps and the parts of the
+// requests in flight that have not arrived.
+QList<TimelineBackfill::Range> TimelineBackfill::openGaps(void) const
+{
+  QList<Range> gaps;
+  foreach (Range gap, mGaps) {
+    if (gap.sinceId > 0)
+      gaps.append(gap);
+  }
+  for (QHash<QNetworkReply*, Page>::const_iterator i = mInFlight.constBegin(); i != mInFlight.constEnd(); ++i) {
+    Range rest;
+    if (unfilled(i.value(), &rest) && rest.sinceId > 0)
+      gaps.append(rest);
+  }
+  return gaps;
+}
+
+
+// Fetches all tweets newer than `sinceId`, or as many as the page budget
+// allows if `sinceId` is 0, then resumes the gaps left open before.
+void TimelineBackfill::start(qlonglong sinceId)
+{
+  if (mRunning)
+    return;
+  mRunning = true;
+  mStopping = false;
+  mPagesRequested = 0;
+  mTweetsReceived = 0;
+  // an open gap without upper bound is the remainder of an earlier top
+  // request which failed before any tweet arrived
+  for (int i = mGaps.count() - 1; i >= 0; --i) {
+    if (mGaps.at(i).maxId == 0)
+      sinceId = qMin(sinceId, mGaps.takeAt(i).sinceId);
+  }
+  mGaps.prepend(Range(sinceId, 0));
+  dispatch();
+}
+
+
+void TimelineBackfill::dispatch(void)
+{
+  while (!mStopping && !mGaps.isEmpty() && mInFlight.count() < mMaxInFlight && mPagesRequested < mMaxPages)
+    request(mGaps.takeFirst());
+  if (mInFlight.isEmpty())
+    finish();
+}
+
+
+void TimelineBackfill::request(const Range &range)
+{
+  QList<O1RequestParameter> params;
+  params << O1RequestParameter("count", QByteArray::number(mPageSize));
+  if (range.sinceId > 0)
+    params << O1RequestParameter("since_id", QByteArray::number(range.sinceId));
+  if (range.maxId > 0)
+    params << O1RequestParameter("max_id", QByteArray::number(range.maxId));
+  QUrl url = mBaseUrl.resolved(QUrl("statuses/home_timeline.json"));
+  QUrlQuery query;
+  foreach (O1RequestParameter param, params)
+    query.addQueryItem(QString::fromLatin1(param.name), QString::fromLatin1(param.value));
+  url.setQuery(query);
+  QNetworkRequest request(url);
+  request.setHeader(QNetworkRequest::ContentTypeHeader, O2_MIME_TYPE_XFORM);
+  QNetworkReply *reply = mRequestor->get(request, params);
+  QObject::connect(reply, SIGNAL(readyRead()), SLOT(onReadyRead()));
+  QObject::connect(reply, SIGNAL(finished()), SLOT(onReplyFinished()));
+  Page page;
+  page.range = range;
+  mInFlight.insert(reply, page);
+  ++mPagesRequested;
+  Metrics::add("backfill/pagesRequested");
+}
+
+
+// Splits the gap into as many ranges as free request slots and the
+// estimated number of missing tweets justify, assuming ids are spread
+// evenly over time as they are with Twitter's snowflake ids.
+void TimelineBackfill::addGap(const Range &range, qlonglong idsPerTweet)
+{
+  Metrics::add("backfill/gapsDetected");
+  if (range.sinceId == 0 || idsPerTweet <= 0) {
+    mGaps.append(range);
+    return;
+  }
+  const qlonglong extent = range.maxId - range.sinceId;
+  const qlonglong pagesNeeded = 1 + extent / idsPerTweet / mPageSize;
+  const int slots = qMax(1, mMaxInFlight - mInFlight.count());
+  const int parts = int(qMin(qlonglong(slots), pagesNeeded));
+  qlonglong lo = range.sinceId;
+  for (int i = 1; i <= parts; ++i) {
+    const qlonglong hi = (i == parts) ? range.maxId : range.sinceId + extent / parts * i;
+    mGaps.append(Range(lo, hi));
+    lo = hi;
+  }
+}
+
+
+void TimelineBackfill::onReadyRead(void)
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (reply == Q_NULLPTR || !mInFlight.contains(reply))
+    return;
+  // error bodies are read as a whole when the reply has finished
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400)
+    return;
+  consume(reply, mInFlight[reply]);
+}
+
+
+// Sets `rest` to the part of the page's range below its oldest tweet
+// received so far, or to the whole range if none has arrived. Returns
+// false if nothing is left.
+bool TimelineBackfill::unfilled(const Page &page, Range *rest)
+{
+  *rest = Range(page.range.sinceId, page.oldest > 0 ? page.oldest - 1 : page.range.maxId);
+  return rest->maxId == 0 || rest->maxId > rest->sinceId;
+}
+
+
+// Feeds what has arrived of `reply` to its parser and passes on the
+// tweets completed by it.
+void TimelineBackfill::consume(QNetworkReply *reply, Page &page)
+{
+  const QJsonArray &tweets = page.parser.feed(reply->readAll());
+  if (tweets.isEmpty())
+    return;
+  foreach (QJsonValue tweet, tweets) {
+    const qlonglong id = TweetStore::tweetId(tweet.toObject());
+    page.newest = qMax(page.newest, id);
+    page.oldest = (page.oldest == 0) ? id : qMin(page.oldest, id);
+  }
+  mTweetsReceived += tweets.count();
+  Metrics::add("backfill/tweetsReceived", tweets.count());
+  emit pageReceived(tweets);
+}
+
+
+void TimelineBackfill::onReplyFinished(void)
+{
+  QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+  if (reply == Q_NULLPTR || !mInFlight.contains(reply))
+    return;
+  reply->deleteLater();
+  if (reply->hasRawHeader("x-rate-limit-remaining")) {
+    emit rateLimitUpdated(reply->rawHeader("x-rate-limit-remaining").toInt(),
+                          reply->rawHeader("x-rate-limit-limit").toInt(),
+                          reply->rawHeader("x-rate-limit-reset").toLongLong());
+  }
+  Range rest;
+  if (reply->error() != QNetworkReply::NoError) {
+    // no more pages for this run; what the failed one has not delivered
+    // stays open, as do the gaps not requested yet
+    Metrics::add("backfill/errors");
+    const Page &page = mInFlight.take(reply);
+    if (unfilled(page, &rest))
+      mGaps.append(rest);
+    mStopping = true;
+    if (reply->error() != QNetworkReply::OperationCanceledError)
+      emit failed(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), reply->errorString(), reply->readAll());
+  }
+  else {
+    // consumed in place, so that openGaps() sees the tweets it delivers
+    consume(reply, mInFlight[reply]);
+    mInFlight[reply].parser.finish();
+    const Page &page = mInFlight.take(reply);
+    const int count = page.parser.objectCount();
+    if (page.parser.hasError()) {
+      // cut off or garbled: the rest of the range is unaccounted for
+      qWarning() << "TimelineBackfill: malformed timeline after" << count << "tweets";
+      Metrics::add("backfill/malformed");
+      if (unfilled(page, &rest))
+        mGaps.append(rest);
+    }
+    else if (count > 0 && page.oldest - 1 > page.range.sinceId) {
+      // there may be more tweets below its oldest one even if the page is
+      // short: deleted and withheld tweets are filtered out after the
+      // count has been applied, so only an empty page proves the range done
+      if (count < mPageSize)
+        Metrics::add("backfill/shortPages");
+      addGap(Range(page.range.sinceId, page.oldest - 1), (page.newest - page.oldest) / qMax(1, count - 1));
+    }
+  }
+  emit gapsChanged();
+  dispatch();
+}
+
+
+void TimelineBackfill::finish(void)
+{
+  if (!mRunning)
+    return;
+  mRunning = false;
+  for (int i = mGaps.count() - 1; i >= 0; --i) {
+    if (mGaps.at(i).sinceId == 0)
+      mGaps.removeAt(i);
+  }
+  if (!mGaps.isEmpty()) {
+    Metrics::add("backfill/gapsLeftOpen", mGaps.count());
+    qWarning() << "TimelineBackfill:" << mGaps.count() << "gaps left open for the next refresh";
+  }
+  emit gapsChanged();
+  qDebug() << "TimelineBackfill:" << mTweetsReceived << "tweets in" << mPagesRequested << "pages";
+  emit finished(mTweetsReceived, mPagesRequested);
+}
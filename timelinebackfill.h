@@ -0,0 +1,124 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TIMELINEBACKFILL_H_
+#define __TIMELINEBACKFILL_H_
+
+#include <QObject>
+#include <QUrl>
+#include <QList>
+#include <QHash>
+#include <QJsonArray>
+#include <QNetworkReply>
+
+#include "jsonstreamparser.h"
+
+class QNetworkAccessManager;
+class O1Requestor;
+class O1Twitter;
+
+
+// Fetches the home timeline down to a given id. Unless a page comes
+// back empty, the id range between its oldest tweet and the lower bound
+// is a gap that may hold more tweets; the API may return short pages
+// while older tweets exist. Gaps whose extent is known are
+// split into id ranges that are requested in parallel; without a lower
+// bound (on first run) the engine pages backwards with max_id, one page
+// at a time, until the page budget is spent. Replies are parsed while
+// they arrive and their tweets handed out through pageReceived() in
+// batches as soon as they are complete.
+//
+// Gaps that are not filled when the budget is spent or a request fails
+// stay open and are resumed by the next start(). openGaps() returns them
+// together with the unfilled parts of the requests in flight, so that
+// they can be persisted alongside the since_id watermark; gapsChanged()
+// tells when they change. Gaps below the first page of a first run are
+// history, not lost tweets, and are dropped.
+class TimelineBackfill : public QObject
+{
+  Q_OBJECT
+
+public:
+  enum {
+    DefaultPageSize = 200,
+    DefaultMaxInFlight = 3,
+    DefaultMaxPages = 8
+  };
+
+  // tweets with sinceId < id <= maxId; maxId == 0 means no upper bound
+  struct Range {
+    Range(void) : sinceId(0), maxId(0) { /* ... */ }
+    Range(qlonglong sinceId, qlonglong maxId) : sinceId(sinceId), maxId(maxId) { /* ... */ }
+    qlonglong sinceId;
+    qlonglong maxId;
+  };
+
+  TimelineBackfill(QNetworkAccessManager *nam, O1Twitter *oauth, QObject *parent = Q_NULLPTR);
+
+  void setBaseUrl(const QUrl &url);
+  void setMaxInFlight(int n);
+  void setMaxPages(int n);
+  bool isRunning(void) const;
+  void setOpenGaps(const QList<Range> &gaps);
+  QList<Range> openGaps(void) const;
+
+public slots:
+  void start(qlonglong sinceId);
+
+signals:
+  void pageReceived(const QJsonArray &tweets);
+  void failed(int httpStatus, const QString &errorString, const QByteArray &body);
+  void rateLimitUpdated(int remaining, int limit, qint64 reset);
+  void finished(int tweets, int pages);
+  void gapsChanged(void);
+
+private slots:
+  void onReadyRead(void);
+  void onReplyFinished(void);
+
+private:
+  struct Page {
+    Page(void) : newest(0), oldest(0) { /* ... */ }
+    Range range;
+    JsonStreamParser parser;
+    qlonglong newest;
+    qlonglong oldest;
+  };
+
+  void dispatch(void);
+  void consume(QNetworkReply *reply, Page &page);
+  void request(const Range &range);
+  void addGap(const Range &range, qlonglong idsPerTweet);
+  static bool unfilled(const Page &page, Range *rest);
+  void finish(void);
+
+  O1Requestor *mRequestor;
+  QUrl mBaseUrl;
+  int mPageSize;
+  int mMaxInFlight;
+  int mMaxPages;
+  QList<Range> mGaps;
+  QHash<QNetworkReply*, Page> mInFlight;
+  int mPagesRequested;
+  int mTweetsReceived;
+  bool mRunning;
+  bool mStopping;
+};
+
+#endif // __TIMELINEBACKFILL_H_
@@ -0,0 +1,223 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <QPainter>
+#include <QFontMetrics>
+#include <QRegExp>
+
+#include "tokenstrip.h"
+
+static const QColor TokenBackground(0xff, 0xda, 0xb9);
+static const QColor TokenBorder(0x44, 0x44, 0x44);
+
+
+TokenStrip::TokenStrip(QWidget *parent)
+  : QWidget(parent)
+  , mLineHeight(0)
+  , mLayoutWidth(-1)
+  , mHeightForWidthKey(-1)
+  , mHeightForWidthValue(0)
+  , mPressed(-1)
+{
+  QFont f = font();
+  f.setPointSize(12);
+  setFont(f);
+  setMouseTracking(true);
+  QSizePolicy policy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+  policy.setHeightForWidth(true);
+  setSizePolicy(policy);
+  mLineHeight = fontMetrics().height() + 2 * (PaddingY + 1);
+}
+
+
+void TokenStrip::setText(const QString &text)
+{
+  static const QRegExp delim("\\s", Qt::CaseSensitive, QRegExp::RegExp2);
+  mTokens = text.split(delim, QString::SkipEmptyParts);
+  const QFontMetrics &fm = fontMetrics();
+  mWidths.resize(mTokens.count());
+  for (int i = 0; i < mTokens.count(); ++i) {
+    QHash<QString, int>::const_iterator w = mWidthCache.constFind(mTokens.at(i));
+    if (w == mWidthCache.constEnd())
+      w = mWidthCache.insert(mTokens.at(i), fm.width(mTokens.at(i)));
+    mWidths[i] = w.value();
+  }
+  if (mWidthCache.count() > 10000)
+    mWidthCache.clear();
+  mPressed = -1;
+  mHeightForWidthKey = -1;
+  mLayoutWidth = -1;
+  relayout();
+  updateGeometry();
+  update();
+}
+
+
+// Returns the index of the token at `pos`, or -1 if there is none.
+int TokenStrip::tokenAt(const QPoint &pos) const
+{
+  for (int i = 0; i < mRects.count(); ++i) {
+    if (mRects.at(i).contains(pos))
+      return i;
+    if (mRects.at(i).top() > pos.y())
+      break;
+  }
+  return -1;
+}
+
+
+bool TokenStrip::hasHeightForWidth(void) const
+{
+  return true;
+}
+
+
+int TokenStrip::heightForWidth(int width) const
+{
+  if (width != mHeightForWidthKey) {
+    mHeightForWidthValue = layoutTokens(width, Q_NULLPTR);
+    mHeightForWidthKey = width;
+  }
+  return mHeightForWidthValue;
+}
+
+
+QSize TokenStrip::sizeHint(void) const
+{
+  const int w = qMax(width(), minimumSizeHint().width());
+  return QSize(w, heightForWidth(w));
+}
+
+
+QSize TokenStrip::minimumSizeHint(void) const
+{
+  int w = 0;
+  for (int i = 0; i < mWidths.count(); ++i)
+    w = qMax(w, tokenSize(i).width());
+  return QSize(w + 2 * Margin, mLineHeight + 2 * Margin);
+}
+
+
+QSize TokenStrip::tokenSize(int i) const
+{
+  return QSize(mWidths.at(i) + 2 * (PaddingX + 1), mLineHeight);
+}
+
+
+// Places the tokens line by line into `width` pixels and returns the
+// height needed. The rectangles are only stored if `rects` is given.
+int TokenStrip::layoutTokens(int width, QVector<QRect> *rects) const
+{
+  if (rects != Q_NULLPTR)
+    rects->resize(mTokens.count());
+  const int right = width - Margin;
+  int x = Margin;
+  int y = Margin;
+  for (int i = 0; i < mTokens.count(); ++i) {
+    const QSize &size = tokenSize(i);
+    if (x + size.width() > right && x > Margin) {
+      x = Margin;
+      y += mLineHeight + Spacing;
+    }
+    if (rects != Q_NULLPTR)
+      (*rects)[i] = QRect(QPoint(x, y), size);
+    x += size.width() + Spacing;
+  }
+  return mTokens.isEmpty() ? 2 * Margin : y + mLineHeight + Margin;
+}
+
+
+void TokenStrip::relayout(void)
+{
+  if (mLayoutWidth == width())
+    return;
+  mLayoutWidth = width();
+  layoutTokens(mLayoutWidth, &mRects);
+}
+
+
+void TokenStrip::paintEvent(QPaintEvent *e)
+{
+  QPainter p(this);
+  p.setFont(font());
+  for (int i = 0; i < mRects.count(); ++i) {
+    const QRect &r = mRects.at(i);
+    if (r.top() > e->rect().bottom())
+      break;
+    if (!r.intersects(e->rect()))
+      continue;
+    p.setPen(TokenBorder);
+    p.setBrush(TokenBackground);
+    p.drawRect(r.adjusted(0, 0, -1, -1));
+    p.setPen(palette().color(QPalette::ButtonText));
+    p.drawText(r, Qt::AlignCenter, mTokens.at(i));
+  }
+}
+
+
+void TokenStrip::resizeEvent(QResizeEvent *e)
+{
+  relayout();
+  QWidget::resizeEvent(e);
+}
+
+
+// Presses on a token are taken, all others are passed on to the parent
+// so that the card can still be dragged by its background.
+void TokenStrip::mousePressEvent(QMouseEvent *e)
+{
+  mPressed = e->button() == Qt::LeftButton ? tokenAt(e->pos()) : -1;
+  if (mPressed < 0)
+    e->ignore();
+}
+
+
+void TokenStrip::mouseReleaseEvent(QMouseEvent *e)
+{
+  if (mPressed < 0) {
+    e->ignore();
+    return;
+  }
+  if (e->button() == Qt::LeftButton && tokenAt(e->pos()) == mPressed)
+    emit tokenClicked(mTokens.at(mPressed));
+  mPressed = -1;
+}
+
+
+void TokenStrip::mouseMoveEvent(QMouseEvent *e)
+{
+  if (tokenAt(e->pos()) >= 0)
+    setCursor(Qt::PointingHandCursor);
+  else
+    unsetCursor();
+  if (mPressed < 0)
+    e->ignore();
+}
+
+
+void TokenStrip::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::FontChange) {
+    mWidthCache.clear();
+    mLineHeight = fontMetrics().height() + 2 * (PaddingY + 1);
+    setText(mTokens.join(' '));
+  }
+  QWidget::changeEvent(e);
+}
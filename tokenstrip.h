@@ -0,0 +1,90 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef __TOKENSTRIP_H_
+#define __TOKENSTRIP_H_
+
+#include <QWidget>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QRect>
+#include <QPoint>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QResizeEvent>
+#include <QEvent>
+
+
+// Shows the words of a tweet as clickable tokens flowing over as many
+// lines as needed. Instead of one widget per word, the strip measures,
+// lays out and paints the tokens itself; word widths are cached per font
+// and the layout is recomputed only when the text or the width changes.
+class TokenStrip : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit TokenStrip(QWidget *parent = Q_NULLPTR);
+
+  void setText(const QString &text);
+  int tokenAt(const QPoint &pos) const;
+
+  bool hasHeightForWidth(void) const Q_DECL_OVERRIDE;
+  int heightForWidth(int width) const Q_DECL_OVERRIDE;
+  QSize sizeHint(void) const Q_DECL_OVERRIDE;
+  QSize minimumSizeHint(void) const Q_DECL_OVERRIDE;
+
+signals:
+  void tokenClicked(const QString &token);
+
+protected:
+  void paintEvent(QPaintEvent*) Q_DECL_OVERRIDE;
+  void resizeEvent(QResizeEvent*) Q_DECL_OVERRIDE;
+  void mousePressEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+  void mouseReleaseEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+  void mouseMoveEvent(QMouseEvent*) Q_DECL_OVERRIDE;
+  void changeEvent(QEvent*) Q_DECL_OVERRIDE;
+
+private:
+  enum {
+    Margin = 2,
+    Spacing = 2,
+    PaddingX = 2,
+    PaddingY = 1
+  };
+
+  QSize tokenSize(int i) const;
+  int layoutTokens(int width, QVector<QRect> *rects) const;
+  void relayout(void);
+
+  QStringList mTokens;
+  QVector<int> mWidths;
+  mutable QHash<QString, int> mWidthCache;
+  int mLineHeight;
+  QVector<QRect> mRects;
+  int mLayoutWidth;
+  mutable int mHeightForWidthKey;
+  mutable int mHeightForWidthValue;
+  int mPressed;
+};
+
+#endif // __TOKENSTRIP_H_
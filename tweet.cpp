@@ -0,0 +1,90 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+
+#include "tweet.h"
+
+// Users are kept in chunks of fixed size that are never reallocated.
+// The index handed out by intern() reaches other threads along with the
+// tweets referring to it, so readers see the entry fully written.
+static const int ChunkBits = 10;
+static const int ChunkSize = 1 << ChunkBits;
+static const int MaxChunks = 4096;
+
+static QMutex userTableMutex;
+static TweetUser *userChunks[MaxChunks];
+static QAtomicInt userCount;
+static QHash<QByteArray, int> userIndex;
+
+
+// Returns the index of the user with the given UTF-8 encoded name and
+// avatar URL, adding the user if it is new. Only new users are decoded.
+int UserTable::intern(const QByteArray &nameUtf8, const QByteArray &profileImageUrlUtf8)
+{
+  QByteArray key;
+  key.reserve(nameUtf8.size() + 1 + profileImageUrlUtf8.size());
+  key.append(nameUtf8).append('\0').append(profileImageUrlUtf8);
+  QMutexLocker locker(&userTableMutex);
+  QHash<QByteArray, int>::const_iterator i = userIndex.constFind(key);
+  if (i != userIndex.constEnd())
+    return i.value();
+  const int n = userCount.load();
+  if ((n >> ChunkBits) >= MaxChunks)
+    return -1;
+  TweetUser *&chunk = userChunks[n >> ChunkBits];
+  if (chunk == Q_NULLPTR)
+    chunk = new TweetUser[ChunkSize];
+  TweetUser &user = chunk[n & (ChunkSize - 1)];
+  user.name = QString::fromUtf8(nameUtf8);
+  user.profileImageUrl = QUrl(QString::fromUtf8(profileImageUrlUtf8));
+  userIndex.insert(key, n);
+  userCount.storeRelease(n + 1);
+  return n;
+}
+
+
+int UserTable::intern(const QString &name, const QString &profileImageUrl)
+{
+  return intern(name.toUtf8(), profileImageUrl.toUtf8());
+}
+
+
+const TweetUser &UserTable::at(int user)
+{
+  static const TweetUser none;
+  if (user < 0 || user >= userCount.loadAcquire())
+    return none;
+  return userChunks[user >> ChunkBits][user & (ChunkSize - 1)];
+}
+
+
+const QString &Tweet::userName(void) const
+{
+  return UserTable::at(user).name;
+}
+
+
+const QUrl &Tweet::profileImageUrl(void) const
+{
+  return UserTable::at(user).profileImageUrl;
+}
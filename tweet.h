@@ -0,0 +1,67 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TWEET_H_
+#define __TWEET_H_
+
+#include <QString>
+#include <QUrl>
+#include <QByteArray>
+#include <QtGlobal>
+
+
+// Author data shared by all tweets of the same user.
+struct TweetUser
+{
+  QString name;
+  QUrl profileImageUrl;
+};
+
+
+// Process-wide table of interned authors. Tweets refer to their
+// author by index, so that name and avatar URL are stored and parsed
+// only once per user. Interning is thread-safe. Entries never move once
+// added, so at() needs no lock and returns a reference that stays valid.
+class UserTable
+{
+public:
+  static int intern(const QByteArray &nameUtf8, const QByteArray &profileImageUrlUtf8);
+  static int intern(const QString &name, const QString &profileImageUrl);
+  static const TweetUser &at(int user);
+};
+
+
+// The fields of a tweet the UI works with, decoded once.
+struct Tweet
+{
+  Tweet(void) : id(0), createdAt(0), user(-1) { /* ... */ }
+
+  bool isValid(void) const { return id != 0; }
+  const QString &userName(void) const;
+  const QUrl &profileImageUrl(void) const;
+
+  qlonglong id;
+  qint64 createdAt; // seconds since epoch (UTC)
+  QString text;
+  int user; // index into UserTable
+};
+
+Q_DECLARE_TYPEINFO(Tweet, Q_MOVABLE_TYPE);
+
+#endif // __TWEET_H_
@@ -0,0 +1,110 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QMap>
+
+#include "tweetprojection.h"
+
+
+TweetProjection::TweetProjection(const QStringList &fields)
+{
+  build(fields);
+}
+
+
+// Groups the paths by their first component so that every key is
+// looked up once per object, however many subfields are selected.
+void TweetProjection::build(const QStringList &fields)
+{
+  QMap<QString, QStringList> groups;
+  QStringList whole;
+  foreach (QString field, fields) {
+    field = field.trimmed();
+    if (field.isEmpty())
+      continue;
+    const int dot = field.indexOf('.');
+    if (dot < 0) {
+      whole << field;
+      groups[field];
+    }
+    else {
+      groups[field.left(dot)] << field.mid(dot + 1);
+    }
+  }
+  for (QMap<QString, QStringList>::const_iterator i = groups.constBegin(); i != groups.constEnd(); ++i) {
+    Node node;
+    node.key = i.key();
+    if (!whole.contains(i.key()))
+      node.sub = QSharedPointer<TweetProjection>(new TweetProjection(i.value()));
+    mNodes.append(node);
+  }
+}
+
+
+QJsonObject TweetProjection::apply(const QJsonObject &tweet) const
+{
+  QJsonObject result;
+  foreach (Node node, mNodes) {
+    const QJsonObject::const_iterator v = tweet.constFind(node.key);
+    if (v == tweet.constEnd())
+      continue;
+    if (node.sub.isNull()) {
+      result.insert(node.key, v.value());
+    }
+    else if (v.value().isObject()) {
+      result.insert(node.key, node.sub->apply(v.value().toObject()));
+    }
+    else if (v.value().isArray()) {
+      result.insert(node.key, node.sub->apply(v.value().toArray()));
+    }
+  }
+  return result;
+}
+
+
+QJsonArray TweetProjection::apply(const QJsonArray &tweets) const
+{
+  QJsonArray result;
+  foreach (QJsonValue value, tweets)
+    result.append(value.isObject() ? QJsonValue(apply(value.toObject())) : value);
+  return result;
+}
+
+
+// The fields read by the UI and the stores plus those used as features
+// for training.
+QStringList TweetProjection::defaultFields(void)
+{
+  return QStringList()
+      << "id"
+      << "id_str"
+      << "created_at"
+      << "text"
+      << "lang"
+      << "in_reply_to_status_id_str"
+      << "retweet_count"
+      << "favorite_count"
+      << "user.id_str"
+      << "user.name"
+      << "user.screen_name"
+      << "user.profile_image_url"
+      << "entities.hashtags.text"
+      << "entities.urls.expanded_url"
+      << "entities.user_mentions.screen_name";
+}
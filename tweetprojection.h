@@ -0,0 +1,56 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TWEETPROJECTION_H_
+#define __TWEETPROJECTION_H_
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+#include <QJsonObject>
+#include <QJsonArray>
+
+
+// Whitelist of tweet fields to keep when tweets enter the stores.
+// Fields are given as dotted paths, e.g. "user.name"; a path that
+// ends in an array of objects selects the named key of every element,
+// e.g. "entities.hashtags.text".
+class TweetProjection
+{
+public:
+  explicit TweetProjection(const QStringList &fields = defaultFields());
+
+  QJsonObject apply(const QJsonObject &tweet) const;
+  QJsonArray apply(const QJsonArray &tweets) const;
+
+  static QStringList defaultFields(void);
+
+private:
+  struct Node {
+    QString key;
+    QSharedPointer<TweetProjection> sub; // null: keep the whole value
+  };
+
+  void build(const QStringList &fields);
+
+  QVector<Node> mNodes;
+};
+
+#endif // __TWEETPROJECTION_H_
@@ -0,0 +1,557 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QLocale>
+#include <QVariant>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "tweetstore.h"
+
+// File layout (all integers little endian):
+//
+//   header   magic "TWS1", version, record count, record size,
+//            heap offset (64 bit), heap size (64 bit)
+//   records  one per tweet, sorted by ascending id:
+//            id (64 bit), created_at in seconds since epoch (64 bit),
+//            then offset and length (32 bit each) into the heap for
+//            text, user name, profile image URL and the compact JSON
+//   heap     UTF-8 strings referenced by the records
+static const char Magic[4] = { 'T', 'W', 'S', '1' };
+static const quint32 Version = 1;
+static const int HeaderSize = 32;
+static const int RecordSize = 48;
+static const int FieldsOffset = 16;
+
+
+// Extracts field number `field` (in the order of the record layout
+// above) from a tweet that has not been written to disk yet.
+static QByteArray jsonField(const QJsonObject &tweet, int field)
+{
+  switch (field) {
+  case 0:
+    return tweet["text"].toString().toUtf8();
+  case 1:
+    return tweet["user"].toObject()["name"].toString().toUtf8();
+  case 2:
+    return tweet["user"].toObject()["profile_image_url"].toString().toUtf8();
+  default:
+    return QJsonDocument(tweet).toJson(QJsonDocument::Compact);
+  }
+}
+
+
+static void putField(uchar *record, int field, const QByteArray &value, QByteArray &heap)
+{
+  qToLittleEndian<quint32>(quint32(heap.size()), record + FieldsOffset + 8 * field);
+  qToLittleEndian<quint32>(quint32(value.size()), record + FieldsOffset + 8 * field + 4);
+  heap.append(value);
+}
+
+
+TweetStore::TweetStore(void)
+  : mRecords(Q_NULLPTR)
+  , mHeap(Q_NULLPTR)
+{
+  /* ... */
+}
+
+
+bool TweetStore::open(const QString &filename)
+{
+  clear();
+  QSharedPointer<QFile> file(new QFile(filename));
+  if (!file->open(QIODevice::ReadOnly))
+    return false;
+  const qint64 size = file->size();
+  if (size < HeaderSize)
+    return false;
+  const uchar *data = file->map(0, size);
+  if (data == Q_NULLPTR || !attach(data, size)) {
+    qWarning() << "TweetStore::open() invalid file" << filename;
+    return false;
+  }
+  mFile = file;
+  return true;
+}
+
+
+// Switches to the store file `filename`, e.g. after a snapshot has been
+// written in the background. Tweets contained in the new file are read
+// from there, all others stay in memory. The set of tweets is unchanged.
+bool TweetStore::rebase(const QString &filename)
+{
+  TweetStore base;
+  if (!base.open(filename))
+    return false;
+  QVector<Entry> entries;
+  entries.reserve(mEntries.count());
+  QHash<qlonglong, QJsonObject> pending;
+  QVector<Entry>::const_iterator b = base.mEntries.constBegin();
+  foreach (Entry e, mEntries) {
+    while (b != base.mEntries.constEnd() && b->id < e.id)
+      ++b;
+    if (b != base.mEntries.constEnd() && b->id == e.id) {
+      entries.append(Entry(b->id, b->record, e.user));
+    }
+    else {
+      entries.append(Entry(e.id, -1, e.user));
+      pending.insert(e.id, e.record >= 0 ? QJsonDocument::fromJson(field(e, Json)).object() : mPending[e.id]);
+    }
+  }
+  mFile = base.mFile;
+  mData.clear();
+  mRecords = base.mRecords;
+  mHeap = base.mHeap;
+  mEntries = entries;
+  mPending = pending;
+  return true;
+}
+
+
+// Uses `data` (e.g. a decompressed archive segment) instead of a mapped file.
+bool TweetStore::openData(const QByteArray &data)
+{
+  clear();
+  if (data.size() < HeaderSize || !attach(reinterpret_cast<const uchar*>(data.constData()), data.size()))
+    return false;
+  mData = data;
+  return true;
+}
+
+
+bool TweetStore::attach(const uchar *data, qint64 size)
+{
+  const quint32 recordCount = qFromLittleEndian<quint32>(data + 8);
+  const qint64 heapOffset = qFromLittleEndian<qint64>(data + 16);
+  const qint64 heapSize = qFromLittleEndian<qint64>(data + 24);
+  bool valid = std::memcmp(data, Magic, sizeof(Magic)) == 0
+      && qFromLittleEndian<quint32>(data + 4) == Version
+      && qFromLittleEndian<quint32>(data + 12) == quint32(RecordSize)
+      && recordCount <= quint32(INT_MAX / RecordSize)
+      && heapOffset >= HeaderSize + qint64(recordCount) * RecordSize
+      && heapSize >= 0
+      && heapOffset + heapSize <= size;
+  if (!valid)
+    return false;
+  // every field must lie within the heap and the ids must ascend,
+  // field() and indexOf() rely on both
+  const uchar *records = data + HeaderSize;
+  for (int r = 0; r < int(recordCount); ++r) {
+    const uchar *record = records + r * RecordSize;
+    if (r > 0 && qFromLittleEndian<qint64>(record) <= qFromLittleEndian<qint64>(record - RecordSize))
+      return false;
+    for (int f = 0; f < FieldCount; ++f) {
+      const quint32 offset = qFromLittleEndian<quint32>(record + FieldsOffset + 8 * f);
+      const quint32 length = qFromLittleEndian<quint32>(record + FieldsOffset + 8 * f + 4);
+      if (qint64(offset) + qint64(length) > heapSize || length > quint32(INT_MAX))
+        return false;
+    }
+  }
+  mRecords = records;
+  mHeap = data + heapOffset;
+  mEntries.resize(int(recordCount));
+  for (int r = 0; r < int(recordCount); ++r)
+    mEntries[r] = Entry(qFromLittleEndian<qint64>(recordAt(r)), r, -1);
+  return true;
+}
+
+
+bool TweetStore::save(const QString &filename) const
+{
+  QSaveFile file(filename);
+  if (!file.open(QIODevice::WriteOnly))
+    return false;
+  file.write(toByteArray());
+  return file.commit();
+}
+
+
+// Serializes all tweets. Mapped records are copied verbatim, so only
+// tweets inserted since open() have to be converted from JSON.
+QByteArray TweetStore::toByteArray(void) const
+{
+  QByteArray records;
+  QByteArray heap;
+  records.reserve(mEntries.count() * RecordSize);
+  uchar record[RecordSize];
+  foreach (Entry e, mEntries) {
+    qToLittleEndian<qint64>(e.id, record);
+    if (e.record >= 0) {
+      const uchar *src = recordAt(e.record);
+      std::memcpy(record + 8, src + 8, 8);
+      for (int f = 0; f < FieldCount; ++f) {
+        const quint32 offset = qFromLittleEndian<quint32>(src + FieldsOffset + 8 * f);
+        const quint32 length = qFromLittleEndian<quint32>(src + FieldsOffset + 8 * f + 4);
+        putField(record, f, QByteArray::fromRawData(reinterpret_cast<const char*>(mHeap + offset), int(length)), heap);
+      }
+    }
+    else {
+      const QJsonObject &tweet = mPending[e.id];
+      const QDateTime &createdAt = parseCreatedAt(tweet["created_at"].toString());
+      qToLittleEndian<qint64>(createdAt.isValid() ? createdAt.toMSecsSinceEpoch() / 1000 : 0, record + 8);
+      for (int f = 0; f < FieldCount; ++f) {
+        putField(record, f, jsonField(tweet, f), heap);
+      }
+    }
+    records.append(reinterpret_cast<const char*>(record), RecordSize);
+  }
+  uchar header[HeaderSize];
+  std::memcpy(header, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(Version, header + 4);
+  qToLittleEndian<quint32>(quint32(mEntries.count()), header + 8);
+  qToLittleEndian<quint32>(quint32(RecordSize), header + 12);
+  qToLittleEndian<qint64>(HeaderSize + records.size(), header + 16);
+  qToLittleEndian<qint64>(heap.size(), header + 24);
+
+  QByteArray data;
+  data.reserve(HeaderSize + records.size() + heap.size());
+  data.append(reinterpret_cast<const char*>(header), HeaderSize);
+  data.append(records);
+  data.append(heap);
+  return data;
+}
+
+
+void TweetStore::clear(void)
+{
+  mEntries.clear();
+  mPending.clear();
+  mRecords = Q_NULLPTR;
+  mHeap = Q_NULLPTR;
+  mFile.clear();
+  mData.clear();
+}
+
+
+// Converts a JSON array of tweets as written by earlier versions of
+// Twindicator into the binary format.
+bool TweetStore::importJson(const QString &jsonFilename, const QString &storeFilename)
+{
+  QFile jsonFile(jsonFilename);
+  if (!jsonFile.open(QIODevice::ReadOnly))
+    return false;
+  TweetStore store;
+  store.insert(QJsonDocument::fromJson(jsonFile.readAll()).array());
+  jsonFile.close();
+  qDebug() << "TweetStore::importJson()" << jsonFilename << "->" << storeFilename << store.count() << "tweets";
+  return store.save(storeFilename);
+}
+
+
+// Returns the generations <filename>.<n> written so far, ascending.
+static QList<int> generations(const QString &filename)
+{
+  QList<int> result;
+  const QFileInfo fi(filename);
+  const QStringList &files = fi.dir().entryList(QStringList() << fi.fileName() + ".*", QDir::Files);
+  foreach (QString f, files) {
+    bool ok = false;
+    const int generation = f.mid(fi.fileName().length() + 1).toInt(&ok);
+    if (ok)
+      result << generation;
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+
+// Snapshots are not written over the store file in use, which is mapped
+// and can't be replaced on every platform, but to a new generation
+// <filename>.<n> next to it. Returns the most recent one, or `filename`
+// itself if there is none, as left by importJson() or earlier versions.
+QString TweetStore::currentFile(const QString &filename)
+{
+  const QList<int> &g = generations(filename);
+  return g.isEmpty() ? filename : QString("%1.%2").arg(filename).arg(g.last());
+}
+
+
+QString TweetStore::nextFile(const QString &filename)
+{
+  const QList<int> &g = generations(filename);
+  return QString("%1.%2").arg(filename).arg(g.isEmpty() ? 1 : g.last() + 1);
+}
+
+
+// Deletes all files of the store but the current one. To be called once
+// the store has been rebased onto it; a file that is still mapped
+// elsewhere may resist and is tried again next time.
+void TweetStore::removeStaleFiles(const QString &filename)
+{
+  const QString &current = currentFile(filename);
+  if (current == filename)
+    return;
+  QFile::remove(filename);
+  foreach (int generation, generations(filename)) {
+    const QString &stale = QString("%1.%2").arg(filename).arg(generation);
+    if (stale != current)
+      QFile::remove(stale);
+  }
+}
+
+
+int TweetStore::count(void) const
+{
+  return mEntries.count();
+}
+
+
+bool TweetStore::isEmpty(void) const
+{
+  return mEntries.isEmpty();
+}
+
+
+QVector<TweetStore::Entry>::const_iterator TweetStore::lowerBound(qlonglong id) const
+{
+  return std::lower_bound(mEntries.constBegin(), mEntries.constEnd(), id,
+                          [](const Entry &e, qlonglong id) { return e.id < id; });
+}
+
+
+int TweetStore::indexOf(qlonglong id) const
+{
+  QVector<Entry>::const_iterator it = lowerBound(id);
+  return (it != mEntries.constEnd() && it->id == id) ? mEntries.count() - 1 - int(it - mEntries.constBegin()) : -1;
+}
+
+
+// Returns the number of tweets with an id greater than `id`, i.e. the
+// index `id` has or would have after insertion.
+int TweetStore::countNewerThan(qlonglong id) const
+{
+  return int(mEntries.constEnd() - lowerBound(id + 1));
+}
+
+
+bool TweetStore::contains(qlonglong id) const
+{
+  return indexOf(id) >= 0;
+}
+
+
+qlonglong TweetStore::idAt(int i) const
+{
+  return entry(i).id;
+}
+
+
+// Returns the author's index into UserTable.
+int TweetStore::userAt(int i) const
+{
+  return user(mEntries.count() - 1 - i);
+}
+
+
+// Decodes the fields the UI needs straight from the record, without
+// going through the JSON representation. The author is interned once,
+// so only the text has to be decoded.
+Tweet TweetStore::tweetAt(int i) const
+{
+  Tweet t;
+  // first, as it may detach mEntries
+  t.user = user(mEntries.count() - 1 - i);
+  const Entry &e = entry(i);
+  t.id = e.id;
+  if (e.record < 0) {
+    const QJsonObject &tweet = mPending[e.id];
+    const QDateTime &createdAt = parseCreatedAt(tweet["created_at"].toString());
+    t.createdAt = createdAt.isValid() ? createdAt.toMSecsSinceEpoch() / 1000 : 0;
+    t.text = tweet["text"].toString();
+  }
+  else {
+    t.createdAt = qFromLittleEndian<qint64>(recordAt(e.record) + 8);
+    t.text = QString::fromUtf8(field(e, Text));
+  }
+  return t;
+}
+
+
+QJsonObject TweetStore::at(int i) const
+{
+  const Entry &e = entry(i);
+  if (e.record >= 0)
+    return QJsonDocument::fromJson(field(e, Json)).object();
+  return mPending[e.id];
+}
+
+
+// Removes and returns the most recent tweet in constant time.
+QJsonObject TweetStore::takeFirst(void)
+{
+  if (mEntries.isEmpty())
+    return QJsonObject();
+  const QJsonObject &tweet = at(0);
+  mPending.remove(mEntries.last().id);
+  mEntries.removeLast();
+  return tweet;
+}
+
+
+bool TweetStore::insert(const QJsonObject &tweet)
+{
+  const qlonglong id = tweetId(tweet);
+  if (id == 0)
+    return false;
+  QVector<Entry>::const_iterator it = lowerBound(id);
+  if (it != mEntries.constEnd() && it->id == id)
+    return false;
+  mEntries.insert(int(it - mEntries.constBegin()), Entry(id, -1, internUser(tweet)));
+  mPending.insert(id, tweet);
+  return true;
+}
+
+
+// Inserts a batch of k tweets. As entries are kept in ascending order
+// internally, tweets newer than all stored ones (the usual case after a
+// refresh) are simply appended, which costs O(k log n) for the lookups.
+// Otherwise the batch is merged in a single pass. Returns the number of
+// tweets added.
+int TweetStore::insert(const QJsonArray &tweets)
+{
+  QVector<Entry> added;
+  added.reserve(tweets.count());
+  foreach (QJsonValue value, tweets) {
+    const QJsonObject &tweet = value.toObject();
+    const qlonglong id = tweetId(tweet);
+    if (id == 0 || mPending.contains(id) || contains(id))
+      continue;
+    mPending.insert(id, tweet);
+    added.append(Entry(id, -1, internUser(tweet)));
+  }
+  if (added.isEmpty())
+    return 0;
+  auto ascending = [](const Entry &a, const Entry &b) { return a.id < b.id; };
+  std::sort(added.begin(), added.end(), ascending);
+  if (mEntries.isEmpty() || added.first().id > mEntries.last().id) {
+    mEntries += added;
+  }
+  else {
+    QVector<Entry> merged(mEntries.count() + added.count());
+    std::merge(mEntries.constBegin(), mEntries.constEnd(), added.constBegin(), added.constEnd(), merged.begin(), ascending);
+    mEntries = merged;
+  }
+  return added.count();
+}
+
+
+// Drops all tweets from index `n` on, i.e. all but the `n` most recent ones.
+void TweetStore::truncate(int n)
+{
+  const int dropped = mEntries.count() - n;
+  if (dropped <= 0)
+    return;
+  for (int i = 0; i < dropped; ++i) {
+    if (mEntries.at(i).record < 0)
+      mPending.remove(mEntries.at(i).id);
+  }
+  mEntries.remove(0, dropped);
+}
+
+
+bool TweetStore::remove(qlonglong id)
+{
+  QVector<Entry>::const_iterator it = lowerBound(id);
+  if (it == mEntries.constEnd() || it->id != id)
+    return false;
+  mEntries.remove(int(it - mEntries.constBegin()));
+  mPending.remove(id);
+  return true;
+}
+
+
+qlonglong TweetStore::tweetId(const QJsonObject &tweet)
+{
+  return tweet.contains("id_str")
+      ? tweet["id_str"].toString().toLongLong()
+      : tweet["id"].toVariant().toLongLong();
+}
+
+
+int TweetStore::internUser(const QJsonObject &tweet)
+{
+  const QJsonObject &user = tweet["user"].toObject();
+  return UserTable::intern(user["name"].toString(), user["profile_image_url"].toString());
+}
+
+
+// Parses Twitter's created_at format, e.g. "Wed Aug 27 13:08:45 +0000 2008".
+QDateTime TweetStore::parseCreatedAt(const QString &createdAt)
+{
+  QDateTime dt = QLocale::c().toDateTime(createdAt, "ddd MMM dd HH:mm:ss +0000 yyyy");
+  dt.setTimeSpec(Qt::UTC);
+  return dt;
+}
+
+
+// Returns an in-memory copy of this store with every tweet reduced to
+// the fields selected by `projection`.
+TweetStore TweetStore::projected(const TweetProjection &projection) const
+{
+  QJsonArray tweets;
+  for (int i = count() - 1; i >= 0; --i)
+    tweets.append(projection.apply(at(i)));
+  TweetStore store;
+  store.insert(tweets);
+  return store;
+}
+
+
+const TweetStore::Entry &TweetStore::entry(int i) const
+{
+  return mEntries.at(mEntries.count() - 1 - i);
+}
+
+
+QByteArray TweetStore::field(const Entry &e, Field field) const
+{
+  if (e.record < 0)
+    return jsonField(mPending[e.id], field);
+  const uchar *record = recordAt(e.record);
+  const quint32 offset = qFromLittleEndian<quint32>(record + FieldsOffset + 8 * field);
+  const quint32 length = qFromLittleEndian<quint32>(record + FieldsOffset + 8 * field + 4);
+  return QByteArray::fromRawData(reinterpret_cast<const char*>(mHeap + offset), int(length));
+}
+
+
+// Interns the author of mEntries[`index`] on first use rather than in
+// attach(), so that opening and rebasing a store don't have to visit
+// every record. A store shared with a copy detaches here once.
+int TweetStore::user(int index) const
+{
+  if (mEntries.at(index).user < 0) {
+    Entry &e = mEntries[index];
+    e.user = UserTable::intern(field(e, UserName), field(e, ProfileImageUrl));
+  }
+  return mEntries.at(index).user;
+}
+
+
+const uchar *TweetStore::recordAt(int record) const
+{
+  return mRecords + record * RecordSize;
+}
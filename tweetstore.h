@@ -0,0 +1,111 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TWEETSTORE_H_
+#define __TWEETSTORE_H_
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+#include <QFile>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "tweet.h"
+#include "tweetprojection.h"
+
+
+// A set of tweets ordered by descending id (index 0 is the most recent
+// tweet). Tweets loaded from disk stay in a memory-mapped file of
+// fixed-size records plus a string heap and are decoded on access only;
+// tweets inserted afterwards are kept in memory until the next save().
+class TweetStore
+{
+public:
+  TweetStore(void);
+
+  bool open(const QString &filename);
+  bool openData(const QByteArray &data);
+  bool rebase(const QString &filename);
+  bool save(const QString &filename) const;
+  QByteArray toByteArray(void) const;
+  void clear(void);
+  static bool importJson(const QString &jsonFilename, const QString &storeFilename);
+  static QString currentFile(const QString &filename);
+  static QString nextFile(const QString &filename);
+  static void removeStaleFiles(const QString &filename);
+
+  int count(void) const;
+  bool isEmpty(void) const;
+  int indexOf(qlonglong id) const;
+  int countNewerThan(qlonglong id) const;
+  bool contains(qlonglong id) const;
+  qlonglong idAt(int i) const;
+  int userAt(int i) const;
+  Tweet tweetAt(int i) const;
+  QJsonObject at(int i) const;
+  QJsonObject takeFirst(void);
+  bool insert(const QJsonObject &tweet);
+  int insert(const QJsonArray &tweets);
+  bool remove(qlonglong id);
+  void truncate(int n);
+  TweetStore projected(const TweetProjection &projection) const;
+
+  static qlonglong tweetId(const QJsonObject &tweet);
+  static QDateTime parseCreatedAt(const QString &createdAt);
+  static int internUser(const QJsonObject &tweet);
+
+private:
+  enum Field {
+    Text = 0,
+    UserName,
+    ProfileImageUrl,
+    Json,
+    FieldCount
+  };
+
+  struct Entry {
+    Entry(void) : id(0), record(-1), user(-1) { /* ... */ }
+    Entry(qlonglong id, int record, int user) : id(id), record(record), user(user) { /* ... */ }
+    qlonglong id;
+    int record;
+    int user; // index into UserTable, -1 until interned by user()
+  };
+
+  bool attach(const uchar *data, qint64 size);
+  QVector<Entry>::const_iterator lowerBound(qlonglong id) const;
+  const Entry &entry(int i) const;
+  QByteArray field(const Entry &e, Field field) const;
+  const uchar *recordAt(int record) const;
+  int user(int index) const;
+
+  QSharedPointer<QFile> mFile;
+  QByteArray mData;
+  const uchar *mRecords;
+  const uchar *mHeap;
+  // ascending by id, so that newly arriving tweets are appended
+  // and the most recent tweet is taken from the end
+  mutable QVector<Entry> mEntries;
+  QHash<qlonglong, QJsonObject> mPending;
+};
+
+#endif // __TWEETSTORE_H_
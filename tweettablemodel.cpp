@@ -0,0 +1,288 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QPixmap>
+#include <QPair>
+#include <QVector>
+#include <algorithm>
+
+#include "tweettablemodel.h"
+#include "metrics.h"
+
+// decoded rows kept around, a few screens' worth
+static const int RowCacheSize = 512;
+// delay before a failed avatar is requested again, doubled with every
+// further failure up to the maximum
+static const qint64 AvatarRetryMs = 30 * 1000;
+static const qint64 MaxAvatarRetryMs = 60 * 60 * 1000;
+
+
+TweetTableModel::TweetTableModel(TweetStore *store, AvatarCache *avatars, QObject *parent)
+  : QAbstractTableModel(parent)
+  , mStore(store)
+  , mAvatars(avatars)
+  , mRows(RowCacheSize)
+{
+  mClock.start();
+}
+
+
+int TweetTableModel::rowCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : mStore->count();
+}
+
+
+int TweetTableModel::columnCount(const QModelIndex &parent) const
+{
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+
+QVariant TweetTableModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= mStore->count())
+    return QVariant();
+  const Tweet &tweet = cachedTweet(index.row());
+  switch (role) {
+  case Qt::DisplayRole:
+    switch (index.column()) {
+    case ColumnText:
+      return tweet.text;
+    case ColumnCreatedAt:
+      return QDateTime::fromMSecsSinceEpoch(1000 * tweet.createdAt).toString(Qt::SystemLocaleShortDate);
+    case ColumnId:
+      return QString::number(tweet.id);
+    default:
+      break;
+    }
+    break;
+  case Qt::DecorationRole:
+    if (index.column() == ColumnProfileImage) {
+      const QUrl &url = tweet.profileImageUrl();
+      QPixmap pix;
+      if (mAvatars->find(url, &pix))
+        return pix;
+      mAvatarRows[url].insert(tweet.id);
+      if (!mAvatarsRequested.contains(url) && !avatarBackingOff(url)) {
+        mAvatarsRequested.insert(url);
+        emit const_cast<TweetTableModel*>(this)->avatarNeeded(url);
+      }
+    }
+    break;
+  case Qt::UserRole:
+    if (index.column() == ColumnProfileImage)
+      return tweet.profileImageUrl();
+    break;
+  case Qt::TextAlignmentRole:
+    return int(Qt::AlignTop | Qt::AlignLeft);
+  default:
+    break;
+  }
+  return QVariant();
+}
+
+
+QVariant TweetTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QVariant();
+  switch (section) {
+  case ColumnProfileImage:
+    return tr("Image");
+  case ColumnText:
+    return tr("Tweet");
+  case ColumnCreatedAt:
+    return tr("Created");
+  case ColumnId:
+    return tr("ID");
+  default:
+    return QVariant();
+  }
+}
+
+
+Tweet TweetTableModel::tweetAt(int row) const
+{
+  return cachedTweet(row);
+}
+
+
+// Removes the head of the queue. The store drops it in O(1); attached
+// views are told exactly that row 0 is gone.
+QJsonObject TweetTableModel::takeFirst(void)
+{
+  if (mStore->isEmpty())
+    return QJsonObject();
+  QElapsedTimer t;
+  t.start();
+  beginRemoveRows(QModelIndex(), 0, 0);
+  forgetAvatarRow(0);
+  mRows.remove(mStore->idAt(0));
+  const QJsonObject &tweet = mStore->takeFirst();
+  endRemoveRows();
+  Metrics::add("queue/advances");
+  Metrics::add("queue/advanceNs", t.nsecsElapsed());
+  return tweet;
+}
+
+
+// Inserts the tweets not queued yet. Their final rows are computed up
+// front and consecutive rows are inserted as one batch, newest first,
+// so views only see the rows that are actually new. Returns the number
+// of tweets inserted.
+int TweetTableModel::insert(const QJsonArray &tweets)
+{
+  QVector<QPair<qlonglong, QJsonObject> > fresh;
+  foreach (QJsonValue value, tweets) {
+    const QJsonObject &tweet = value.toObject();
+    const qlonglong id = TweetStore::tweetId(tweet);
+    if (id != 0 && !mStore->contains(id))
+      fresh.append(qMakePair(id, tweet));
+  }
+  std::sort(fresh.begin(), fresh.end(),
+            [](const QPair<qlonglong, QJsonObject> &a, const QPair<qlonglong, QJsonObject> &b) { return a.first > b.first; });
+  fresh.erase(std::unique(fresh.begin(), fresh.end(),
+                          [](const QPair<qlonglong, QJsonObject> &a, const QPair<qlonglong, QJsonObject> &b) { return a.first == b.first; }),
+              fresh.end());
+  int batches = 0;
+  int i = 0;
+  while (i < fresh.count()) {
+    // the fresh tweets before `i` have been inserted already, so this
+    // is the final row; the run goes on as long as no queued tweet
+    // lies between the fresh ones
+    const int first = mStore->countNewerThan(fresh.at(i).first);
+    QJsonArray run;
+    run.append(fresh.at(i).second);
+    int j = i + 1;
+    while (j < fresh.count() && mStore->countNewerThan(fresh.at(j).first) == first) {
+      run.append(fresh.at(j).second);
+      ++j;
+    }
+    beginInsertRows(QModelIndex(), first, first + run.count() - 1);
+    mStore->insert(run);
+    endInsertRows();
+    ++batches;
+    i = j;
+  }
+  Metrics::add("table/rowsInserted", fresh.count());
+  Metrics::add("table/insertBatches", batches);
+  return fresh.count();
+}
+
+
+bool TweetTableModel::removeTweet(int row)
+{
+  if (row < 0 || row >= mStore->count())
+    return false;
+  const qlonglong id = mStore->idAt(row);
+  beginRemoveRows(QModelIndex(), row, row);
+  forgetAvatarRow(row);
+  mRows.remove(id);
+  mStore->remove(id);
+  endRemoveRows();
+  return true;
+}
+
+
+// To be called after the store has been changed behind the model's back.
+void TweetTableModel::reset(void)
+{
+  beginResetModel();
+  mRows.clear();
+  mAvatarRows.clear();
+  endResetModel();
+}
+
+
+// Updates the rows that have been shown without this avatar, one
+// dataChanged() per run of adjacent rows.
+void TweetTableModel::avatarChanged(const QUrl &url)
+{
+  mAvatarsRequested.remove(url);
+  mAvatarFailures.remove(url);
+  const QSet<qlonglong> &ids = mAvatarRows.take(url);
+  QVector<int> rows;
+  rows.reserve(ids.count());
+  foreach (qlonglong id, ids) {
+    const int row = mStore->indexOf(id);
+    if (row >= 0)
+      rows.append(row);
+  }
+  std::sort(rows.begin(), rows.end());
+  for (int i = 0; i < rows.count(); ) {
+    int j = i + 1;
+    while (j < rows.count() && rows.at(j) == rows.at(j - 1) + 1)
+      ++j;
+    emit dataChanged(index(rows.at(i), ColumnProfileImage), index(rows.at(j - 1), ColumnProfileImage), QVector<int>() << Qt::DecorationRole);
+    i = j;
+  }
+}
+
+
+// Lets a paint of a row with this avatar ask for it again, but not
+// before the retry delay has passed, so that a dead URL isn't requested
+// on every repaint.
+void TweetTableModel::avatarFailed(const QUrl &url)
+{
+  mAvatarsRequested.remove(url);
+  AvatarFailure &failure = mAvatarFailures[url];
+  const qint64 delay = qMin(MaxAvatarRetryMs, AvatarRetryMs << qMin(failure.failures, 16));
+  ++failure.failures;
+  failure.retryAt = mClock.elapsed() + delay;
+}
+
+
+bool TweetTableModel::avatarBackingOff(const QUrl &url) const
+{
+  QHash<QUrl, AvatarFailure>::const_iterator i = mAvatarFailures.constFind(url);
+  return i != mAvatarFailures.constEnd() && mClock.elapsed() < i.value().retryAt;
+}
+
+
+void TweetTableModel::forgetAvatarRow(int row)
+{
+  if (mAvatarRows.isEmpty())
+    return;
+  const QUrl &url = UserTable::at(mStore->userAt(row)).profileImageUrl;
+  QHash<QUrl, QSet<qlonglong> >::iterator i = mAvatarRows.find(url);
+  if (i == mAvatarRows.end())
+    return;
+  i.value().remove(mStore->idAt(row));
+  if (i.value().isEmpty())
+    mAvatarRows.erase(i);
+}
+
+
+const Tweet &TweetTableModel::cachedTweet(int row) const
+{
+  const qlonglong id = mStore->idAt(row);
+  Tweet *tweet = mRows.object(id);
+  if (tweet == Q_NULLPTR) {
+    QElapsedTimer t;
+    t.start();
+    tweet = new Tweet(mStore->tweetAt(row));
+    mRows.insert(id, tweet);
+    Metrics::add("table/rowsDecoded");
+    Metrics::add("table/decodeNs", t.nsecsElapsed());
+  }
+  return *tweet;
+}
@@ -0,0 +1,96 @@
+/*
+
+    Copyright (c) 2015 Oliver Lau <ola@ct.de>, Heise Medien GmbH & Co. KG
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __TWEETTABLEMODEL_H_
+#define __TWEETTABLEMODEL_H_
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QSet>
+#include <QHash>
+#include <QUrl>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "tweet.h"
+#include "tweetstore.h"
+#include "avatarcache.h"
+
+
+// Presents the queued tweets of a TweetStore as a table. Rows are only
+// decoded when the view asks for them, and decoded rows are cached by
+// tweet id, so the cost of a view depends on its visible rows, not on
+// the length of the queue. Changes to the queue go through the model
+// so that attached views are notified.
+class TweetTableModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  enum Column {
+    ColumnProfileImage = 0,
+    ColumnText,
+    ColumnCreatedAt,
+    ColumnId,
+    ColumnCount
+  };
+
+  TweetTableModel(TweetStore *store, AvatarCache *avatars, QObject *parent = Q_NULLPTR);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+  Tweet tweetAt(int row) const;
+  QJsonObject takeFirst(void);
+  int insert(const QJsonArray &tweets);
+  bool removeTweet(int row);
+  void reset(void);
+  void avatarChanged(const QUrl &url);
+
+public slots:
+  void avatarFailed(const QUrl &url);
+
+signals:
+  void avatarNeeded(const QUrl &url);
+
+private:
+  struct AvatarFailure {
+    AvatarFailure(void) : failures(0), retryAt(0) { /* ... */ }
+    int failures;
+    qint64 retryAt; // on mClock
+  };
+
+  const Tweet &cachedTweet(int row) const;
+  void forgetAvatarRow(int row);
+  bool avatarBackingOff(const QUrl &url) const;
+
+  TweetStore *mStore;
+  AvatarCache *mAvatars;
+  mutable QCache<qlonglong, Tweet> mRows;
+  mutable QSet<QUrl> mAvatarsRequested;
+  // ids of the tweets shown without their avatar, by avatar URL
+  mutable QHash<QUrl, QSet<qlonglong> > mAvatarRows;
+  QHash<QUrl, AvatarFailure> mAvatarFailures;
+  QElapsedTimer mClock;
+};
+
+#endif // __TWEETTABLEMODEL_H_